@@ -27,6 +27,7 @@
 *******************************************************************************/
 
 #include "_semaphore.hpp"
+#include "_tq.hpp"
 
 
 WEOS_BEGIN_NAMESPACE
@@ -42,6 +43,7 @@ void semaphore::post()
     if (status != osOK)
         WEOS_THROW_SYSTEM_ERROR(WEOS_NAMESPACE::cmsis_error::cmsis_error_t(status),
                                 "semaphore::post failed");
+    m_selectors.notify_all();
 }
 
 void semaphore::wait()
@@ -32,6 +32,7 @@
 #include "_core.hpp"
 
 #include "cmsis_error.hpp"
+#include "_tq_fwd.hpp"
 #include "../chrono.hpp"
 
 #include <cstdint>
@@ -151,9 +152,27 @@ public:
                     static_cast<void*>(&m_cmsisSemaphoreControlBlock));
     }
 
+    //! Checks if a token is available. Used by wait_any().
+    friend
+    bool select_ready(const semaphore& sem)
+    {
+        return sem.value() != 0;
+    }
+
+    //! Returns the queue of the threads which wait for this semaphore in
+    //! wait_any(). Used by wait_any().
+    friend
+    weos_detail::_tq& select_queue(const semaphore& sem) noexcept
+    {
+        return sem.m_selectors;
+    }
+
 private:
     //! The native semaphore.
     ControlBlock m_cmsisSemaphoreControlBlock;
+    //! The threads which wait for this semaphore in wait_any(). It is
+    //! notified whenever the semaphore is posted.
+    mutable weos_detail::_tq m_selectors;
 };
 
 WEOS_END_NAMESPACE
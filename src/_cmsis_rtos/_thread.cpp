@@ -27,6 +27,7 @@
 *******************************************************************************/
 
 #include "_thread.hpp"
+#include "_tq.hpp"
 #include "_svc_indirection.hpp"
 
 #include <cstdint>
@@ -65,6 +66,10 @@ uint32_t rt_tsk_create(void(*task)(void),
 // The function which is called when a thread exits.
 int svcThreadTerminate(void* thread_id);
 
+// Returns the id of the current thread. The function can be found in
+// ${CMSIS-RTOS}/SRC/rt_CMSIS.c.
+osThreadId svcThreadGetId(void);
+
 // An array of pointers to task/thread control blocks. The declaration is
 // from ${CMSIS-RTOS}/INC/RTX_Config.h.
 extern void* os_active_TCB[];
@@ -104,6 +109,23 @@ int weos_unlinkSharedState(void* s) noexcept
 
 SVC_1(weos_unlinkSharedState, int,   void*)
 
+// Stores the shared state of the current thread in the pointer \p s. If the
+// current thread has no shared state, a null-pointer is stored.
+extern "C"
+int weos_findCurrentSharedState(void* s) noexcept
+{
+    using namespace WEOS_NAMESPACE::weos_detail;
+
+    osThreadId threadId = svcThreadGetId();
+    SharedThreadStateBase* iter = g_sharedThreadStates;
+    while (iter != nullptr && iter->m_threadId != threadId)
+        iter = iter->m_next;
+    *static_cast<SharedThreadStateBase**>(s) = iter;
+    return 0;
+}
+
+SVC_1(weos_findCurrentSharedState, int,   void*)
+
 // ----=====================================================================----
 //     Thread observers
 // ----=====================================================================----
@@ -618,6 +640,7 @@ void thread::set_signals(signal_set flags)
     std::int32_t result = osSignalSet(m_data->m_threadId, flags);
     WEOS_ASSERT(result >= 0);
     (void)result;
+    m_data->m_signalSelectors.notify_one();
 }
 
 void thread::do_create(weos_detail::ThreadProperties& props,
@@ -675,6 +698,27 @@ void thread::do_create(weos_detail::ThreadProperties& props,
     }
 }
 
+namespace weos_detail
+{
+
+thread::signal_set current_signals()
+{
+    // Clearing no flag returns the current ones.
+    std::int32_t result = osSignalClear(osThreadGetId(), 0);
+    WEOS_ASSERT(result >= 0);
+    return thread::signal_set(result);
+}
+
+_tq& current_signal_selectors()
+{
+    SharedThreadStateBase* state = nullptr;
+    weos_findCurrentSharedState_indirect(&state);
+    WEOS_ASSERT(state != nullptr);
+    return state->m_signalSelectors;
+}
+
+} // namespace weos_detail
+
 // ----=====================================================================----
 //     Waiting for signals
 // ----=====================================================================----
@@ -33,6 +33,7 @@
 
 #include "cmsis_error.hpp"
 #include "_thread_detail.hpp"
+#include "_tq_fwd.hpp"
 #include "_sleep.hpp"
 #include "../atomic.hpp"
 #include "../chrono.hpp"
@@ -305,6 +306,10 @@ struct SharedThreadStateBase
     // Points to the next state in the linked list.
     SharedThreadStateBase* m_next;
 
+    // The thread waits in this queue for its signals in wait_any(). It is
+    // notified whenever the signals of this thread are set.
+    _tq m_signalSelectors;
+
     // Pointer to the stack which is owned by the state.
     void* m_ownedStack;
 
@@ -545,6 +550,18 @@ private:
                    weos_detail::SharedThreadStateBase* state);
 };
 
+namespace weos_detail
+{
+
+//! Returns the signal flags of the current thread without resetting them.
+thread::signal_set current_signals();
+
+//! Returns the queue, in which the current thread waits for its signals in
+//! wait_any(). The current thread must have been created as a thread.
+_tq& current_signal_selectors();
+
+} // namespace weos_detail
+
 // ----=====================================================================----
 //     Waiting for signals
 // ----=====================================================================----
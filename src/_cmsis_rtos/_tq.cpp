@@ -47,6 +47,8 @@ int weos_tq_notify(void* q_, uint32_t a_) noexcept
 {
     using namespace WEOS_NAMESPACE::weos_detail;
 
+    // The waiters' semaphores are released directly, because
+    // semaphore::post() would also notify the semaphore's selectors.
     _tq& q = *static_cast<_tq*>(q_);
     if (a_)
     {
@@ -55,7 +57,7 @@ int weos_tq_notify(void* q_, uint32_t a_) noexcept
         {
             uintptr_t iv = i->m_v;
             i->m_v = iv | uintptr_t(3);
-            i->m_s.post();
+            osSemaphoreRelease(i->m_w->m_s.native_handle());
             i = reinterpret_cast<_tq::_t*>(iv & ~uintptr_t(3));
         }
         return 0;
@@ -73,7 +75,7 @@ int weos_tq_notify(void* q_, uint32_t a_) noexcept
             in = reinterpret_cast<_tq::_t*>(iv & ~uintptr_t(3));
         } while (!q.m_h.compare_exchange_weak(i, in));
         i->m_v = iv | uintptr_t(3);
-        i->m_s.post();
+        osSemaphoreRelease(i->m_w->m_s.native_handle());
         return 0;
     }
 }
@@ -175,6 +177,21 @@ namespace weos_detail
 
 _tq::_t::_t(_tq& q)
     : m_tq(q),
+      m_w(this),
+      m_v(0)
+{
+    if (__get_IPSR() != 0U)
+    {
+        WEOS_THROW_SYSTEM_ERROR(WEOS_NAMESPACE::cmsis_error::cmsis_error_t(osErrorISR),
+                                "not allowed in ISR");
+    }
+
+    weos_tq_link_indirect(&m_tq, this);
+}
+
+_tq::_t::_t(_tq& q, _t& waiter)
+    : m_tq(q),
+      m_w(&waiter),
       m_v(0)
 {
     if (__get_IPSR() != 0U)
@@ -37,6 +37,7 @@
 
 #include "_core.hpp"
 
+#include "_tq_fwd.hpp"
 #include "_semaphore.hpp"
 #include "../atomic.hpp"
 #include "../chrono.hpp"
@@ -49,66 +50,56 @@ WEOS_BEGIN_NAMESPACE
 namespace weos_detail
 {
 
-struct _tq
+//! A waiter in a queue (see _tq).
+struct _tq::_t
 {
-    struct _t
-    {
-        _t(_tq& q);
-
-        ~_t()
-        {
-            unlink();
-        }
-
-        _t(const _t&) = delete;
-        _t& operator=(const _t&) = delete;
-
-        bool unlink() noexcept;
-
-        explicit
-        operator bool() const noexcept
-        {
-            return m_v.load() & 1;
-        }
-
-        void wait()
-        {
-            m_s.wait();
-        }
-
-        template <typename TRep, typename TPeriod>
-        inline
-        bool wait_for(const chrono::duration<TRep, TPeriod>& timeout)
-        {
-            return m_s.try_wait_for(timeout);
-        }
-
-        template <typename TClock, typename TDuration>
-        inline
-        bool wait_until(const chrono::time_point<TClock, TDuration>& time)
-        {
-            return m_s.try_wait_until(time);
-        }
-
-        _tq& m_tq;
-        semaphore m_s;
-        atomic<std::uintptr_t> m_v;
-        osPriority m_p;
-    };
+    _t(_tq& q);
 
+    //! Links into the queue \p q. A notification wakes the \p waiter,
+    //! which must outlive this object.
+    _t(_tq& q, _t& waiter);
 
+    ~_t()
+    {
+        unlink();
+    }
 
-    _tq() = default;
+    _t(const _t&) = delete;
+    _t& operator=(const _t&) = delete;
 
-    _tq(const _tq&) = delete;
-    _tq& operator=(const _tq&) = delete;
+    bool unlink() noexcept;
 
-    void notify_one() noexcept;
-    void notify_all() noexcept;
+    explicit
+    operator bool() const noexcept
+    {
+        return m_v.load() & 1;
+    }
 
+    void wait()
+    {
+        m_s.wait();
+    }
 
+    template <typename TRep, typename TPeriod>
+    inline
+    bool wait_for(const chrono::duration<TRep, TPeriod>& timeout)
+    {
+        return m_s.try_wait_for(timeout);
+    }
 
-    atomic<_t*> m_h{nullptr};
+    template <typename TClock, typename TDuration>
+    inline
+    bool wait_until(const chrono::time_point<TClock, TDuration>& time)
+    {
+        return m_s.try_wait_until(time);
+    }
+
+    _tq& m_tq;
+    //! The waiter whose semaphore is posted upon a notification.
+    _t* m_w;
+    semaphore m_s;
+    atomic<std::uintptr_t> m_v;
+    osPriority m_p;
 };
 
 } // namespace weos_detail
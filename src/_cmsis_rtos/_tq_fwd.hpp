@@ -0,0 +1,80 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CMSIS_RTOS_TQ_FWD_HPP
+#define WEOS_CMSIS_RTOS_TQ_FWD_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+#include "_core.hpp"
+
+#include "../atomic.hpp"
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! A queue of waiting threads.
+//! A thread which wants to wait for a condition links a _t object into the
+//! queue, re-checks the condition and only then blocks. A thread can wait in
+//! several queues at once. It links one _t into every queue and passes the
+//! first one as the waiter to the others. A notification of any of them
+//! posts the waiter's semaphore.
+//!
+//! The waiter _t is defined in _tq.hpp. As it contains a semaphore, which
+//! in turn contains a queue for wait_any(), the queue is defined separately.
+struct _tq
+{
+    struct _t;
+
+
+
+    _tq() = default;
+
+    _tq(const _tq&) = delete;
+    _tq& operator=(const _tq&) = delete;
+
+    void notify_one() noexcept;
+    void notify_all() noexcept;
+
+
+
+    atomic<_t*> m_h{nullptr};
+};
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CMSIS_RTOS_TQ_FWD_HPP
@@ -36,9 +36,14 @@
 
 
 #include "_core.hpp"
+#include "_tq.hpp"
 
 #include "../memorypool.hpp"
+#include "../_common/_waitandclaim.hpp"
 #include "../atomic.hpp"
+#include "../chrono.hpp"
+
+#include <utility>
 
 
 WEOS_BEGIN_NAMESPACE
@@ -48,8 +53,13 @@ WEOS_BEGIN_NAMESPACE
 //! Like its non-threaded counterpart, it holds the memory for up to
 //! (\p TNumElem) elements of type \p TElement internally and does not
 //! allocate them on the heap.
-template <typename TElement, std::size_t TNumElem>
-class shared_memory_pool
+//!
+//! The optional \p TLayout determines the placement of the chunks. By
+//! default, the chunks are packed densely (compact_chunk_layout). With
+//! cacheline_aligned, every chunk starts on a new cache line.
+template <typename TElement, std::size_t TNumElem,
+          typename TLayout = compact_chunk_layout>
+class shared_memory_pool : public weos_detail::PoolStatistics
 {
 public:
     //! The type of the elements in this pool.
@@ -58,23 +68,7 @@ public:
 private:
     static_assert(TNumElem > 0, "The number of elements must be non-zero.");
 
-    // Every chunk has to be aligned such that it can contain either a
-    // void* or an element_type.
-    static const std::size_t chunk_align =
-            alignment_of<void*>::value > alignment_of<element_type>::value
-            ? alignment_of<void*>::value
-            : alignment_of<element_type>::value;
-    // The chunk size has to be large enough to store a void* or an element.
-    static const std::size_t chunk_size =
-            sizeof(void*) > sizeof(element_type)
-            ? sizeof(void*)
-            : sizeof(element_type);
-
-    // One chunk must be large enough for a void* or an element_type and it
-    // must be aligned to the stricter of both. Furthermore, the alignment
-    // must be a multiple of the size. The aligned_storage<> takes care
-    // of this.
-    typedef typename aligned_storage<chunk_size, chunk_align>::type chunk_type;
+    typedef typename weos_detail::PoolChunk<element_type, TLayout>::type chunk_type;
 
     // The control block of a memory box. Defined as OS_BM in
     // ${CMSIS-RTOS}/SRC/rt_TypeDef.h.
@@ -88,12 +82,16 @@ private:
 
 public:
     //! Constructs a shared memory pool.
-    shared_memory_pool() noexcept
+    //! The constructor runs in constant time and is a constant expression.
+    //! The free-list of the memory box starts empty. Chunks which have never
+    //! been allocated are handed out by incrementing a bump index. The pool
+    //! does not point to itself. Thus, a pool with static storage duration
+    //! is placed in the .bss section.
+    constexpr shared_memory_pool() noexcept
+        : m_controlBlock{0, 0, 0},
+          m_uninitialized(),
+          m_bump(0)
     {
-        m_controlBlock.free = weos_detail::FreeList(
-                                  &m_chunks[0], sizeof(chunk_type), TNumElem).first();
-        m_controlBlock.end = &m_chunks[TNumElem];
-        m_controlBlock.chunkSize = sizeof(chunk_type);
     }
 
     shared_memory_pool(const shared_memory_pool&) = delete;
@@ -113,7 +111,8 @@ public:
     {
         // TODO: what memory order to use here?
         atomic_thread_fence(memory_order_seq_cst);
-        return m_controlBlock.free == 0;
+        return m_controlBlock.free == 0
+               && m_bump.load(memory_order_relaxed) == TNumElem;
     }
 
     //! Allocates a chunk from the pool.
@@ -125,8 +124,54 @@ public:
     //! \sa free()
     void* try_allocate() noexcept
     {
-        return osPoolAlloc(static_cast<osPoolId>(
-                               static_cast<void*>(&m_controlBlock)));
+        void* chunk = pop();
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until a chunk
+    //! is freed.
+    //!
+    //! \sa free()
+    void* allocate()
+    {
+        void* chunk = weos_detail::wait_and_claim(m_tq, [this] {
+            return pop();
+        });
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Allocates a chunk from the pool with a timeout.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until either a
+    //! chunk is freed or the timeout duration \p d expires. In the latter
+    //! case, a null-pointer is returned.
+    //!
+    //! \sa free()
+    template <typename TRep, typename TPeriod>
+    void* try_allocate_for(const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_allocate_until(chrono::steady_clock::now() + d);
+    }
+
+    //! Allocates a chunk from the pool with a timeout.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until either a
+    //! chunk is freed or the point in time \p time has been reached. In the
+    //! latter case, a null-pointer is returned.
+    //!
+    //! \sa free()
+    template <typename TClock, typename TDuration>
+    void* try_allocate_until(const chrono::time_point<TClock, TDuration>& time)
+    {
+        void* chunk = weos_detail::wait_and_claim_until(m_tq, [this] {
+            return pop();
+        }, time);
+        this->record_allocation(chunk);
+        return chunk;
     }
 
     //! Frees a chunk of memory.
@@ -142,6 +187,79 @@ public:
                                       static_cast<void*>(&m_controlBlock)),
                                   chunk);
         WEOS_ASSERT(ret == osOK);
+        this->record_free();
+        m_tq.notify_one();
+    }
+
+    //! Allocates multiple chunks from the pool.
+    //! Allocates up to \p n chunks and stores pointers to them in the
+    //! array \p chunks. The method returns the number of allocated chunks,
+    //! which is less than \p n if the pool runs empty.
+    //!
+    //! \note CMSIS-RTOS has no batch allocation, which is why the chunks
+    //! are allocated one after the other.
+    //!
+    //! \note This method may be called in an interrupt context.
+    //!
+    //! \sa free_n()
+    std::size_t try_allocate_n(void** chunks, std::size_t n) noexcept
+    {
+        std::size_t count = 0;
+        while (count < n)
+        {
+            void* chunk = try_allocate();
+            if (!chunk)
+                break;
+            chunks[count++] = chunk;
+        }
+        return count;
+    }
+
+    //! Frees multiple chunks.
+    //! Returns the \p n chunks in the array \p chunks back to the pool.
+    //! All of them must have been allocated from this pool.
+    //!
+    //! \note This method may be called in an interrupt context.
+    //!
+    //! \sa try_allocate_n()
+    void free_n(void** chunks, std::size_t n) noexcept
+    {
+        for (std::size_t idx = 0; idx < n; ++idx)
+            free(chunks[idx]);
+    }
+
+    //! Iterates over the allocated chunks.
+    //! Calls \p f for every allocated chunk in the order of increasing
+    //! addresses. The function is passed a void pointer to the chunk. It may
+    //! free the chunk but it must not allocate from the pool.
+    //!
+    //! In order to find the allocated chunks, the free-list is sorted by
+    //! address first. Thus, the iteration takes O(F log F + N) steps for F
+    //! free chunks and N chunks which have been allocated at least once.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool during the iteration.
+    template <typename TFunction>
+    void for_each_allocated(TFunction&& f)
+    {
+        m_controlBlock.free = weos_detail::sort_chunk_list(m_controlBlock.free);
+        weos_detail::for_each_chunk_not_in(
+                    m_controlBlock.free, &m_chunks[0], sizeof(chunk_type),
+                    m_bump.load(memory_order_relaxed),
+                    std::forward<TFunction>(f));
+    }
+
+    //! Frees all chunks.
+    //! Returns all chunks to the pool in constant time.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool concurrently.
+    void clear() noexcept
+    {
+        m_controlBlock.free = 0;
+        m_bump = 0;
+        this->record_clear();
+        m_tq.notify_all();
     }
 
 private:
@@ -150,7 +268,50 @@ private:
     //! check of the chunk to be freed, which involves the control block.
     ControlBlock m_controlBlock;
     //! The memory chunks for the elements and the free-list pointers.
-    chunk_type m_chunks[TNumElem];
+    //! The constructor initializes the dummy instead of the chunks, so that
+    //! the chunks are not filled at run-time.
+    union
+    {
+        char m_uninitialized;
+        chunk_type m_chunks[TNumElem];
+    };
+    //! The number of chunks, which have been handed out by the bump index.
+    atomic<std::uint32_t> m_bump;
+    //! The threads which wait for a chunk.
+    weos_detail::_tq m_tq;
+
+    //! Takes a chunk from the CMSIS memory box. If its free-list is empty,
+    //! a chunk which has never been allocated is taken.
+    void* pop() noexcept
+    {
+        void* chunk = osPoolAlloc(static_cast<osPoolId>(
+                                      static_cast<void*>(&m_controlBlock)));
+        if (chunk)
+            return chunk;
+
+        std::uint32_t index = m_bump.load(memory_order_relaxed);
+        do
+        {
+            if (index == TNumElem)
+                return 0;
+        } while (!m_bump.compare_exchange_weak(index, index + 1,
+                                               memory_order_relaxed));
+        complete_control_block();
+        return &m_chunks[index];
+    }
+
+    //! Sets the end of the memory box and the chunk size in the control
+    //! block. They are only needed by osPoolFree(), which cannot be called
+    //! before a chunk has been handed out. Concurrent callers store the same
+    //! values.
+    void complete_control_block() noexcept
+    {
+        if (m_controlBlock.end == 0)
+        {
+            m_controlBlock.chunkSize = sizeof(chunk_type);
+            m_controlBlock.end = &m_chunks[TNumElem];
+        }
+    }
 };
 
 WEOS_END_NAMESPACE
@@ -31,13 +31,14 @@
 
 #include "_core.hpp"
 
+#include "_tq.hpp"
 #include "cmsis_error.hpp"
 #include "../chrono.hpp"
-#include "../semaphore.hpp"
-#include "../memory.hpp"
-#include "../memorypool.hpp"
 #include "../type_traits.hpp"
 #include "../utility.hpp"
+#include "../_common/_mpmcmessagequeue.hpp"
+#include "../_common/_prioritymessagequeue.hpp"
+#include "../_common/_spscmessagequeue.hpp"
 
 #include <cstddef>
 #include <cstdint>
@@ -49,6 +50,29 @@ WEOS_BEGIN_NAMESPACE
 namespace weos_detail
 {
 
+// Returns the timeout in milliseconds for the next CMSIS wait call in order
+// to wait until the given time point. The timeout is clamped to the maximum
+// which CMSIS-RTOS supports. A zero is returned if the time point has been
+// reached.
+template <typename TClock, typename TDuration>
+std::uint32_t cmsis_timeout_until(const chrono::time_point<TClock, TDuration>& time)
+{
+    using namespace chrono;
+
+    static_assert(osCMSIS_RTX <= ((4<<16) | 80), "Check the maximum timeout.");
+
+    auto remainingSpan = time - TClock::now();
+    if (remainingSpan <= TDuration::zero())
+        return 0;
+
+    milliseconds converted = duration_cast<milliseconds>(remainingSpan);
+    if (converted < milliseconds(1))
+        converted = milliseconds(1);
+    else if (converted > milliseconds(0xFFFE))
+        converted = milliseconds(0xFFFE);
+    return converted.count();
+}
+
 template <typename TType, std::size_t TQueueSize>
 class SmallMessageQueue
 {
@@ -64,6 +88,60 @@ class SmallMessageQueue
 public:
     typedef TType value_type;
 
+    // The osMessage queue does not provide access to its slots. Thus, the
+    // reserved element is kept in the reservation and it is copied to the
+    // queue upon commit(). A reservation, which is destroyed without having
+    // been committed, discards its element. Sending from the destructor
+    // could block or throw.
+    class reservation
+    {
+    public:
+        reservation(reservation&& other) noexcept
+            : m_queue(other.m_queue),
+              m_value(other.m_value)
+        {
+            other.m_queue = nullptr;
+        }
+
+        ~reservation() = default;
+
+        reservation(const reservation&) = delete;
+        reservation& operator=(const reservation&) = delete;
+
+        value_type& operator*() noexcept
+        {
+            return m_value;
+        }
+
+        value_type* operator->() noexcept
+        {
+            return &m_value;
+        }
+
+        void commit()
+        {
+            if (m_queue)
+            {
+                SmallMessageQueue* queue = m_queue;
+                m_queue = nullptr;
+                queue->send(m_value);
+            }
+        }
+
+    private:
+        explicit
+        reservation(SmallMessageQueue* queue) noexcept
+            : m_queue(queue),
+              m_value()
+        {
+        }
+
+        SmallMessageQueue* m_queue;
+        value_type m_value;
+
+        friend class SmallMessageQueue;
+    };
+
     SmallMessageQueue()
         : m_id(0)
     {
@@ -131,6 +209,7 @@ public:
         if (status != osOK)
             WEOS_THROW_SYSTEM_ERROR(WEOS_NAMESPACE::cmsis_error::cmsis_error_t(status),
                                     "message_queue::send failed");
+        m_selectors.notify_one();
     }
 
     bool try_send(value_type value) noexcept
@@ -140,198 +219,202 @@ public:
         char* to = reinterpret_cast<char*>(&datum);
         for (unsigned idx = 0; idx < sizeof(value); ++idx)
             to[idx] = from[idx];
-        return osMessagePut(m_id, datum, 0) == osOK;
+        if (osMessagePut(m_id, datum, 0) != osOK)
+            return false;
+        m_selectors.notify_one();
+        return true;
     }
 
-private:
-    //! The storage for the message queue.
-    std::uint32_t m_queueData[4 + TQueueSize];
-    //! The id of the message queue.
-    osMessageQId m_id;
-};
-
-template <typename TType, std::size_t TQueueSize>
-class LargeMessageQueue
-{
-    using memory_pool_t = shared_memory_pool<TType, TQueueSize>;
-
-    struct Deleter
+    template <typename... TArgs>
+    void emplace(TArgs&&... args)
     {
-        typedef void* pointer;
-
-        Deleter(memory_pool_t& pool)
-            : m_pool(pool)
-        {
-        }
-
-        void operator()(pointer p) noexcept
-        {
-            m_pool.free(p);
-        }
-
-    private:
-        memory_pool_t& m_pool;
-    };
-
-public:
-    typedef TType value_type;
+        send(value_type(std::forward<TArgs>(args)...));
+    }
 
-    LargeMessageQueue()
-        : m_numAvailable(TQueueSize)
+    template <typename... TArgs>
+    bool try_emplace(TArgs&&... args)
     {
+        return try_send(value_type(std::forward<TArgs>(args)...));
     }
 
-    value_type receive()
+    reservation reserve()
     {
-        using namespace std;
+        return reservation(this);
+    }
 
-        void* mem = m_pointerQueue.receive();
-        WEOS_ASSERT(mem != nullptr);
+    template <typename TFunction>
+    void consume(TFunction&& f)
+    {
+        value_type value = receive();
+        f(value);
+    }
 
-        // TODO: this could throw, so we need a unique_ptr here
-        value_type temp(move(*static_cast<value_type*>(mem)));
-        static_cast<value_type*>(mem)->~TType();
-        m_memoryPool.free(mem);
-        m_numAvailable.post();
-        return temp;
+    template <typename TFunction>
+    bool try_consume(TFunction&& f)
+    {
+        value_type value;
+        if (!try_receive(value))
+            return false;
+        f(value);
+        return true;
     }
 
-    bool try_receive(value_type& value)
+    template <typename TRep, typename TPeriod>
+    bool try_receive_for(value_type& value,
+                         const chrono::duration<TRep, TPeriod>& d)
     {
-        using namespace std;
+        return try_receive_until(value, chrono::steady_clock::now() + d);
+    }
 
-        void* mem;
-        bool result = m_pointerQueue.try_receive(mem);
-        if (result)
-        {
-            WEOS_ASSERT(mem != nullptr);
-            value = move(*static_cast<value_type*>(mem));
-            static_cast<value_type*>(mem)->~TType();
-            m_memoryPool.free(mem);
-            m_numAvailable.post();
-            return true;
-        }
-        else
+    // The wait is split into chunks, which CMSIS-RTOS can handle, until the
+    // time point has been reached.
+    template <typename TClock, typename TDuration>
+    bool try_receive_until(value_type& value,
+                           const chrono::time_point<TClock, TDuration>& time)
+    {
+        for (;;)
         {
-            return false;
+            std::uint32_t timeout = cmsis_timeout_until(time);
+            osEvent result = osMessageGet(m_id, timeout);
+            if (result.status == osEventMessage)
+            {
+                const char* from = reinterpret_cast<const char*>(&result.value.v);
+                char* to = reinterpret_cast<char*>(&value);
+                for (unsigned idx = 0; idx < sizeof(value); ++idx)
+                    to[idx] = from[idx];
+                return true;
+            }
+            else if (result.status != osOK && result.status != osEventTimeout)
+            {
+                WEOS_THROW_SYSTEM_ERROR(WEOS_NAMESPACE::cmsis_error::cmsis_error_t(result.status),
+                                        "message_queue::try_receive_until failed");
+            }
+
+            if (timeout == 0)
+                return false;
         }
     }
 
-    void send(const value_type& element)
+    template <typename TRep, typename TPeriod>
+    bool try_send_for(value_type value,
+                      const chrono::duration<TRep, TPeriod>& d)
     {
-        using namespace std;
-
-        m_numAvailable.wait();
-
-        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate(),
-                                      Deleter(m_memoryPool));
-        WEOS_ASSERT(mem != nullptr);
-        new (mem.get()) value_type(element);
-        m_pointerQueue.send(mem.release());
+        return try_send_until(value, chrono::steady_clock::now() + d);
     }
 
-    void send(value_type&& element)
+    template <typename TClock, typename TDuration>
+    bool try_send_until(value_type value,
+                        const chrono::time_point<TClock, TDuration>& time)
     {
-        using namespace std;
-
-        m_numAvailable.wait();
+        std::uint32_t datum = 0;
+        const char* from = reinterpret_cast<const char*>(&value);
+        char* to = reinterpret_cast<char*>(&datum);
+        for (unsigned idx = 0; idx < sizeof(value); ++idx)
+            to[idx] = from[idx];
 
-        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate(),
-                                      Deleter(m_memoryPool));
-        WEOS_ASSERT(mem != nullptr);
-        new (mem.get()) value_type(move(element));
-        m_pointerQueue.send(mem.release());
+        for (;;)
+        {
+            std::uint32_t timeout = cmsis_timeout_until(time);
+            osStatus status = osMessagePut(m_id, datum, timeout);
+            if (status == osOK)
+            {
+                m_selectors.notify_one();
+                return true;
+            }
+            else if (   status != osErrorResource
+                     && status != osErrorTimeoutResource)
+            {
+                WEOS_THROW_SYSTEM_ERROR(WEOS_NAMESPACE::cmsis_error::cmsis_error_t(status),
+                                        "message_queue::try_send_until failed");
+            }
+
+            if (timeout == 0)
+                return false;
+        }
     }
 
-    bool try_send(const value_type& element) // TODO: noexcept if constructor does not throw
-    {
-        using namespace std;
-
-        // TODO: Make this work in an interrupt context.
-        if (!m_numAvailable.try_wait())
-            return false;
+    // CMSIS-RTOS has no batch operations for message queues. The elements
+    // are transfered one by one.
 
-        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate(),
-                                      Deleter(m_memoryPool));
-        WEOS_ASSERT(mem != nullptr);
-        new (mem.get()) value_type(element);
-        bool result = m_pointerQueue.try_send(mem.release());
-        WEOS_ASSERT(result);
-        (void)result;
-        return true;
+    template <typename TForwardIterator>
+    void send_n(TForwardIterator first, TForwardIterator last)
+    {
+        for (; first != last; ++first)
+            send(*first);
     }
 
-    bool try_send(value_type&& element) // TODO: noexcept if constructor does not throw
+    template <typename TForwardIterator>
+    std::size_t try_send_n(TForwardIterator first, TForwardIterator last)
     {
-        using namespace std;
+        std::size_t count = 0;
+        for (; first != last && try_send(*first); ++first)
+            ++count;
+        return count;
+    }
 
-        // TODO: Make this work in an interrupt context.
-        if (!m_numAvailable.try_wait())
-            return false;
+    template <typename TOutputIterator>
+    std::size_t receive_n(TOutputIterator out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
 
-        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate(),
-                                      Deleter(m_memoryPool));
-        WEOS_ASSERT(mem != nullptr);
-        new (mem.get()) value_type(move(element));
-        bool result = m_pointerQueue.try_send(mem.release());
-        WEOS_ASSERT(result);
-        (void)result;
-        return true;
+        *out = receive();
+        ++out;
+        std::size_t count = 1;
+        value_type value;
+        while (count < max && try_receive(value))
+        {
+            *out = value;
+            ++out;
+            ++count;
+        }
+        return count;
     }
 
-#if 0
-    atomic<int> m_numAwailable;
-    sempahore m_trigger;
-
-    value_type _receive()
+    template <typename TFunction>
+    std::size_t drain(TFunction&& f)
     {
-        void* mem = m_pointerQueue.receive();
-        WEOS_ASSERT(mem != nullptr);
-        value_type temp(std::move(*static_cast<value_type*>(mem)));
-        static_cast<value_type*>(mem)->~TType();
-        m_memoryPool.free(mem);
-        if (++m_numAvailable <= 0)
-            m_trigger.post();
-        return temp;
+        std::size_t count = 0;
+        value_type value;
+        while (count < TQueueSize && try_receive(value))
+        {
+            f(std::move(value));
+            ++count;
+        }
+        return count;
     }
 
-    void _send(const value_type& element)
+    // The number of messages is read from the control block of the mailbox
+    // (OS_MCB in ${CMSIS-RTOS}/SRC/rt_TypeDef.h). It is a 16-bit value at
+    // offset 12.
+    static_assert(osCMSIS_RTX <= ((4<<16) | 80), "Check the layout of OS_MCB.");
+
+    //! Checks if an element can be received. Used by wait_any().
+    friend
+    bool select_ready(const SmallMessageQueue& queue) noexcept
     {
-        if (--m_numAwailable < 0)
-            m_trigger.wait();
-        void* mem = m_memoryPool.try_allocate();
-        WEOS_ASSERT(mem != nullptr);
-        // TODO: unique_ptr
-        new (mem) value_type(element);
-        m_pointerQueue.send(mem);
+        const volatile std::uint16_t* count
+                = reinterpret_cast<const volatile std::uint16_t*>(
+                      &queue.m_queueData[3]);
+        return *count != 0;
     }
 
-    bool _try_send(const value_type& element)
+    //! Returns the queue of the threads which wait for an element in
+    //! wait_any(). The receivers, which block in the kernel, are not part
+    //! of it.
+    friend
+    _tq& select_queue(SmallMessageQueue& queue) noexcept
     {
-        int available = m_numAwailable;
-        while (available > 0 && !m_numAwailable.compare_exchange_weak(available, available - 1))
-        {
-        }
-        if (available <= 0)
-            return false;
-
-        void* mem = m_memoryPool.try_allocate();
-        WEOS_ASSERT(mem != nullptr);
-        // TODO: unique_ptr
-        new (mem) value_type(element);
-        bool result = m_pointerQueue.try_send(mem);
-        WEOS_ASSERT(result);
-        (void)result;
+        return queue.m_selectors;
     }
-#endif
 
 private:
-    // The number of slots which are available.
-    semaphore m_numAvailable;
-    // A pool to hold the elements which are currently enqueued.
-    memory_pool_t m_memoryPool;
-    // A queue to pass element pointers from one thread to the other.
-    SmallMessageQueue<void*, TQueueSize> m_pointerQueue;
+    //! The storage for the message queue.
+    std::uint32_t m_queueData[4 + TQueueSize];
+    //! The id of the message queue.
+    osMessageQId m_id;
+    //! The threads which wait for an element in wait_any().
+    _tq m_selectors;
 };
 
 template <typename TType, std::size_t TQueueSize>
@@ -341,10 +424,18 @@ struct select_message_queue_implementation
     static const bool has_small_alignment = std::alignment_of<TType>::value
                                             <= std::alignment_of<std::uint32_t>::value;
     static const bool can_be_copied = std::is_trivially_copyable<TType>::value;
-
-    typedef typename std::conditional<is_small && has_small_alignment && can_be_copied,
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+    // The OS' message queue cannot carry the time stamps for the statistics.
+    static const bool can_be_recorded = false;
+#else
+    static const bool can_be_recorded = true;
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+    typedef typename std::conditional<is_small && has_small_alignment && can_be_copied
+                                      && can_be_recorded,
                                       SmallMessageQueue<TType, TQueueSize>,
-                                      LargeMessageQueue<TType, TQueueSize>>::type type;
+                                      MpmcMessageQueue<TType, TQueueSize,
+                                                       MessageQueueStatistics<TQueueSize>>>::type type;
 };
 
 } // namespace weos_detail
@@ -352,6 +443,10 @@ struct select_message_queue_implementation
 //! A message queue.
 //! The message_queue is an object to pass elements from one thread to another
 //! in a thread-safe manner. The object statically holds the necessary memory.
+//!
+//! If the macro WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS is defined in the user
+//! configuration, the queue records its occupancy and the latency of the
+//! elements, which can be queried with statistics().
 template <typename TType, std::size_t TQueueSize>
 class message_queue
         : public weos_detail::select_message_queue_implementation<TType, TQueueSize>::type
@@ -390,29 +485,26 @@ public:
     //! the returned element is default-constructed.
     // bool try_receive(value_type& value);
 
-#if 0
-    //! Tries to receive an element from the queue.
-    //! Tries to receive an element from the message queue within the timeout
-    //! duration \p d.
-    //! The element is returned together with a boolean, which is set if the
-    //! queue was non-empty. If the queue was empty, the boolean is reset and
-    //! the returned element is default-constructed.
-    template <typename RepT, typename PeriodT>
-    std::pair<bool, value_type> try_receive_for(
-            const chrono::duration<RepT, PeriodT>& d)
-    {
-        try_receiver receiver(m_id);
-        if (chrono::detail::cmsis_wait<
-                RepT, PeriodT, try_receiver>::wait(d, receiver))
-        {
-            value_type element;
-            std::memcpy(&element, &receiver.datum(), sizeof(value_type));
-            return std::pair<bool, value_type>(true, element);
-        }
-
-        return std::pair<bool, value_type>(false, value_type());
-    }
-#endif
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until either an element is added
+    //! or the timeout duration \p d expires. Returns \p true and stores the
+    //! element in \p value upon success. Timeouts beyond the limit of
+    //! CMSIS-RTOS are supported.
+    // template <typename TRep, typename TPeriod>
+    // bool try_receive_for(value_type& value,
+    //                      const chrono::duration<TRep, TPeriod>& d);
+
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until either an element is added
+    //! or the point in time \p time has been reached. Returns \p true and
+    //! stores the element in \p value upon success.
+    // template <typename TClock, typename TDuration>
+    // bool try_receive_until(value_type& value,
+    //                        const chrono::time_point<TClock, TDuration>& time);
 
     //! \brief Sends an element via the queue.
     //!
@@ -430,22 +522,96 @@ public:
     //! calling thread is never blocked.
     // bool try_send(const value_type& element);
 
-#if 0
-    //! Tries to send an element via the queue.
-    //! Tries to send the given \p element via the queue and returns \p true
-    //! if successful. If there is no space available within the
-    //! duration \p d, the operation is aborted an \p false is returned.
-    template <typename RepT, typename PeriodT>
-    bool try_send_for(value_type element,
-                      const chrono::duration<RepT, PeriodT>& d)
-    {
-        std::uint32_t datum = 0;
-        std::memcpy(&datum, &element, sizeof(value_type));
-        try_sender sender(m_id, datum);
-        return chrono::detail::cmsis_wait<
-                RepT, PeriodT, try_sender>::wait(d, sender);
-    }
-#endif
+    //! \brief Sends multiple elements via the queue.
+    //!
+    //! Appends the elements in the range [\p first, \p last) to the queue.
+    //! If the queue is full, the calling thread is blocked until space
+    //! becomes available.
+    // template <typename TForwardIterator>
+    // void send_n(TForwardIterator first, TForwardIterator last);
+
+    //! \brief Tries to send multiple elements via the queue.
+    //!
+    //! Appends as many elements from the range [\p first, \p last) as
+    //! fit into the queue and returns their number. The calling thread is
+    //! never blocked.
+    // template <typename TForwardIterator>
+    // std::size_t try_send_n(TForwardIterator first, TForwardIterator last);
+
+    //! \brief Receives multiple elements from the queue.
+    //!
+    //! Moves up to \p max elements to the output iterator \p out and
+    //! returns their number. If the queue is empty, the calling thread is
+    //! blocked until at least one element is available.
+    // template <typename TOutputIterator>
+    // std::size_t receive_n(TOutputIterator out, std::size_t max);
+
+    //! \brief Drains the queue.
+    //!
+    //! Calls \p f for every element which is currently in the queue and
+    //! returns the number of elements. The calling thread is never blocked.
+    // template <typename TFunction>
+    // std::size_t drain(TFunction&& f);
+
+    //! \brief Constructs an element in the queue.
+    //!
+    //! Constructs an element from the arguments \p args at the end of the
+    //! queue. For elements which do not fit into the osMessage queue, the
+    //! element is constructed directly in the queue's storage. If the queue
+    //! is full, the calling thread is blocked until space becomes available.
+    // template <typename... TArgs>
+    // void emplace(TArgs&&... args);
+
+    //! \brief Tries to construct an element in the queue.
+    //!
+    //! Like emplace() but returns \p false if the queue is full.
+    // template <typename... TArgs>
+    // bool try_emplace(TArgs&&... args);
+
+    //! \brief Reserves a slot in the queue.
+    //!
+    //! Returns a reservation for a default-constructed element, which can be
+    //! filled in place. The element is sent when the reservation is
+    //! committed and discarded when the reservation is destroyed without
+    //! a commit. For elements, which do not fit into the
+    //! osMessage queue, the slot is reserved immediately (blocking while the
+    //! queue is full). Otherwise, the element is kept in the reservation
+    //! and commit() blocks.
+    // reservation reserve();
+
+    //! \brief Consumes an element in place.
+    //!
+    //! Calls \p f with a reference to the first element in the queue and
+    //! releases the element afterwards. If the queue is empty, the calling
+    //! thread is blocked until an element is added.
+    // template <typename TFunction>
+    // void consume(TFunction&& f);
+
+    //! \brief Tries to consume an element in place.
+    //!
+    //! Like consume() but returns \p false if the queue is empty.
+    // template <typename TFunction>
+    // bool try_consume(TFunction&& f);
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the queue. If the queue is full,
+    //! the calling thread is blocked until either space becomes available or
+    //! the timeout duration \p d expires. Returns \p true, if the element
+    //! has been added. Timeouts beyond the limit of CMSIS-RTOS are supported.
+    // template <typename TRep, typename TPeriod>
+    // bool try_send_for(const value_type& element,
+    //                   const chrono::duration<TRep, TPeriod>& d);
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the queue. If the queue is full,
+    //! the calling thread is blocked until either space becomes available or
+    //! the point in time \p time has been reached. Returns \p true, if the
+    //! element has been added.
+    // template <typename TClock, typename TDuration>
+    // bool try_send_until(const value_type& element,
+    //                     const chrono::time_point<TClock, TDuration>& time);
 };
 
 WEOS_END_NAMESPACE
@@ -0,0 +1,83 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_BITOPS_HPP
+#define WEOS_COMMON_BITOPS_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! Returns the number of leading zero bits in \p x, which must be non-zero.
+inline
+unsigned count_leading_zeros(std::uint32_t x) noexcept
+{
+#if defined(__CC_ARM)
+    return __clz(x);
+#elif defined(__GNUC__)
+    return __builtin_clz(x);
+#else
+    unsigned count = 0;
+    while ((x & 0x80000000) == 0)
+    {
+        x <<= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+//! Returns the number of trailing zero bits in \p x, which must be non-zero.
+inline
+unsigned count_trailing_zeros(std::uint32_t x) noexcept
+{
+#if defined(__CC_ARM)
+    return __clz(__rbit(x));
+#elif defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    // Isolate the lowest set bit.
+    return 31 - count_leading_zeros(x & (~x + 1));
+#endif
+}
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_BITOPS_HPP
@@ -0,0 +1,198 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_MESSAGEQUEUESTATISTICS_HPP
+#define WEOS_COMMON_MESSAGEQUEUESTATISTICS_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+#include "_bitops.hpp"
+#include "../atomic.hpp"
+#include "../chrono.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! Occupancy and latency statistics of a message queue.
+//! The statistics are only recorded if the macro
+//! WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS is defined in the user configuration.
+struct message_queue_statistics
+{
+    //! The number of buckets in the latency histogram.
+    static const std::size_t num_latency_buckets = 24;
+
+    //! The number of elements which are currently in the queue.
+    std::size_t current_size;
+    //! The maximum number of elements which have been in the queue at the
+    //! same time.
+    std::size_t high_water_mark;
+    //! The number of sends which found the queue full. A send is counted
+    //! once, no matter if it has blocked, timed out or failed immediately.
+    std::size_t send_stalls;
+    //! A histogram of the time which the elements have spent in the queue
+    //! between being sent and being received. Bucket 0 counts the latencies
+    //! below 1us, bucket k counts the latencies in [2^(k-1), 2^k) us and the
+    //! last bucket also counts all larger latencies.
+    std::size_t latency_histogram[num_latency_buckets];
+};
+
+namespace weos_detail
+{
+
+// A mix-in for queues which never record statistics. Its hooks are no-ops
+// and the empty base optimization ensures that it does not increase the
+// size of a queue.
+class NoMessageQueueStatistics
+{
+protected:
+    void record_enqueue(std::size_t) noexcept
+    {
+    }
+
+    void record_dequeue(std::size_t) noexcept
+    {
+    }
+
+    void record_send_stall() noexcept
+    {
+    }
+};
+
+#if defined(WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS)
+
+// A mix-in, which records the statistics of a queue with (TQueueSize)
+// slots. The hooks take the position of a slot in the ring buffer. The
+// enqueue hook has to be called before the slot is published and the
+// dequeue hook before the slot is released. Then the slot's time stamp is
+// ordered by the ring buffer's sequence numbers. The counters are updated
+// with relaxed atomics because they are only informational.
+template <std::size_t TQueueSize>
+class MessageQueueStatistics
+{
+public:
+    //! Returns the occupancy and latency statistics of this queue.
+    message_queue_statistics statistics() const noexcept
+    {
+        message_queue_statistics result;
+        result.current_size = m_currentSize.load(memory_order_relaxed);
+        result.high_water_mark = m_highWaterMark.load(memory_order_relaxed);
+        result.send_stalls = m_sendStalls.load(memory_order_relaxed);
+        for (std::size_t idx = 0; idx < num_buckets; ++idx)
+        {
+            result.latency_histogram[idx]
+                    = m_latencyHistogram[idx].load(memory_order_relaxed);
+        }
+        return result;
+    }
+
+protected:
+    MessageQueueStatistics() noexcept
+        : m_currentSize(0),
+          m_highWaterMark(0),
+          m_sendStalls(0)
+    {
+        for (std::size_t idx = 0; idx < num_buckets; ++idx)
+            m_latencyHistogram[idx].store(0, memory_order_relaxed);
+    }
+
+    void record_enqueue(std::size_t pos) noexcept
+    {
+        m_enqueueTimes[pos % TQueueSize] = chrono::steady_clock::now();
+
+        std::size_t size = m_currentSize.fetch_add(1, memory_order_relaxed) + 1;
+        std::size_t mark = m_highWaterMark.load(memory_order_relaxed);
+        while (size > mark
+               && !m_highWaterMark.compare_exchange_weak(
+                       mark, size, memory_order_relaxed))
+        {
+        }
+    }
+
+    void record_dequeue(std::size_t pos) noexcept
+    {
+        chrono::steady_clock::duration latency
+                = chrono::steady_clock::now() - m_enqueueTimes[pos % TQueueSize];
+        m_latencyHistogram[latency_bucket(latency)].fetch_add(
+                    1, memory_order_relaxed);
+        m_currentSize.fetch_sub(1, memory_order_relaxed);
+    }
+
+    void record_send_stall() noexcept
+    {
+        m_sendStalls.fetch_add(1, memory_order_relaxed);
+    }
+
+private:
+    static const std::size_t num_buckets
+        = message_queue_statistics::num_latency_buckets;
+
+    //! Returns the index of the histogram bucket for the \p latency.
+    static std::size_t latency_bucket(
+            chrono::steady_clock::duration latency) noexcept
+    {
+        auto us = chrono::duration_cast<chrono::microseconds>(latency).count();
+        if (us <= 0)
+            return 0;
+        if (us >= (decltype(us)(1) << (num_buckets - 2)))
+            return num_buckets - 1;
+        return 32 - count_leading_zeros(std::uint32_t(us));
+    }
+
+    atomic<std::size_t> m_currentSize;
+    atomic<std::size_t> m_highWaterMark;
+    atomic<std::size_t> m_sendStalls;
+    atomic<std::size_t> m_latencyHistogram[num_buckets];
+    //! The points in time at which the elements in the slots have been sent.
+    chrono::steady_clock::time_point m_enqueueTimes[TQueueSize];
+};
+
+template <std::size_t TQueueSize>
+const std::size_t MessageQueueStatistics<TQueueSize>::num_buckets;
+
+#else
+
+// Without statistics, the mix-in is empty.
+template <std::size_t TQueueSize>
+class MessageQueueStatistics : public NoMessageQueueStatistics
+{
+};
+
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_MESSAGEQUEUESTATISTICS_HPP
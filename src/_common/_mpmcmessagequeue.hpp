@@ -0,0 +1,993 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_MPMCMESSAGEQUEUE_HPP
+#define WEOS_COMMON_MPMCMESSAGEQUEUE_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+// The wait queue (weos_detail::_tq) is provided by the backend, which has
+// to include its _tq.hpp before this file.
+#include "_messagequeuestatistics.hpp"
+#include "_waitandclaim.hpp"
+#include "../atomic.hpp"
+#include "../chrono.hpp"
+#include "../iterator.hpp"
+#include "../type_traits.hpp"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! A bounded multi-producer/multi-consumer ring buffer.
+//! The MpmcRingBuffer stores up to (\p TSize) elements of type \p TType inline.
+//! Every slot has a sequence number, which tells if the slot is free or
+//! holds an element in the current lap (D. Vyukov's bounded MPMC queue).
+//! The sequence is twice the position of the slot's next producer, while
+//! the slot is free and twice the position plus one, while it holds an
+//! element. Doubling the positions keeps the two states apart even if the
+//! buffer has only a single slot.
+//! Producers and consumers claim a slot by incrementing the tail or head
+//! position with a compare-and-swap. Thus, the buffer never blocks but
+//! an operation fails if the buffer is full or empty.
+//!
+//! Claiming a slot and filling (or emptying) it are separate steps. The
+//! caller has to publish (or release) every slot which it has claimed.
+//! A producer, which cannot fill its slot, publishes it as skipped. The
+//! skip is marked by the highest bit of the sequence, which is never set
+//! by a position. A skipped slot is only claimed on its own, such that a
+//! consumer can release it without looking at the element.
+//!
+//! The positions wrap around at a multiple of the buffer size, such that
+//! the size need not be a power of two.
+template <typename TType, std::size_t TSize>
+class MpmcRingBuffer
+{
+    static_assert(TSize > 0, "The size must be non-zero.");
+
+public:
+    MpmcRingBuffer() noexcept
+        : m_head(0),
+          m_tail(0)
+    {
+        for (std::size_t idx = 0; idx < TSize; ++idx)
+            m_slots[idx].sequence.store(2 * idx, memory_order_relaxed);
+    }
+
+    //! Destroys the elements which are still in the buffer.
+    ~MpmcRingBuffer()
+    {
+        std::size_t pos;
+        while (try_claim_front(pos))
+        {
+            if (!skipped(pos))
+                element(pos)->~TType();
+            release_front(pos);
+        }
+    }
+
+    MpmcRingBuffer(const MpmcRingBuffer&) = delete;
+    MpmcRingBuffer& operator=(const MpmcRingBuffer&) = delete;
+
+    //! Claims the free slot at the back of the buffer. Returns \p true and
+    //! the slot's position in \p pos, if the buffer was not full.
+    bool try_claim_back(std::size_t& pos) noexcept
+    {
+        return try_claim_back_n(pos, 1) != 0;
+    }
+
+    //! Claims up to \p max consecutive free slots at the back of the buffer
+    //! with a single compare-and-swap. Returns the number of claimed slots
+    //! and the position of the first one in \p pos.
+    std::size_t try_claim_back_n(std::size_t& pos, std::size_t max) noexcept
+    {
+        pos = m_tail.load(memory_order_relaxed);
+        if (max == 0)
+            return 0;
+
+        for (;;)
+        {
+            std::ptrdiff_t diff = 0;
+            std::size_t count = 0;
+            for (std::size_t next = pos; count < max; ++count, next = advance(next, 1))
+            {
+                std::size_t sequence = slot(next).sequence.load(memory_order_acquire);
+                diff = distance(sequence & ~skipped_flag, 2 * next);
+                if (diff != 0)
+                    break;
+            }
+
+            if (count == 0 && diff < 0)
+                return 0;
+            if (count == 0)
+                pos = m_tail.load(memory_order_relaxed);
+            else if (m_tail.compare_exchange_weak(pos, advance(pos, count),
+                                                  memory_order_relaxed))
+                return count;
+        }
+    }
+
+    //! Hands the element in the slot at \p pos over to the consumers.
+    void publish_back(std::size_t pos) noexcept
+    {
+        slot(pos).sequence.store(2 * pos + 1, memory_order_release);
+    }
+
+    //! Hands the slot at \p pos, which does not hold an element, over to
+    //! the consumers, which have to skip it.
+    void publish_skipped_back(std::size_t pos) noexcept
+    {
+        slot(pos).sequence.store((2 * pos + 1) | skipped_flag,
+                                 memory_order_release);
+    }
+
+    //! Claims the element at the front of the buffer. Returns \p true and
+    //! the slot's position in \p pos, if the buffer was not empty.
+    bool try_claim_front(std::size_t& pos) noexcept
+    {
+        return try_claim_front_n(pos, 1) != 0;
+    }
+
+    //! Claims up to \p max consecutive elements at the front of the buffer
+    //! with a single compare-and-swap. Returns the number of claimed
+    //! elements and the position of the first one in \p pos.
+    std::size_t try_claim_front_n(std::size_t& pos, std::size_t max) noexcept
+    {
+        pos = m_head.load(memory_order_relaxed);
+        if (max == 0)
+            return 0;
+
+        for (;;)
+        {
+            std::ptrdiff_t diff = 0;
+            std::size_t count = 0;
+            for (std::size_t next = pos; count < max; ++count, next = advance(next, 1))
+            {
+                std::size_t sequence = slot(next).sequence.load(memory_order_acquire);
+                diff = distance(sequence & ~skipped_flag, 2 * next + 1);
+                if (diff != 0)
+                    break;
+                if (sequence & skipped_flag)
+                {
+                    if (count == 0)
+                        ++count;
+                    break;
+                }
+            }
+
+            if (count == 0 && diff < 0)
+                return 0;
+            if (count == 0)
+                pos = m_head.load(memory_order_relaxed);
+            else if (m_head.compare_exchange_weak(pos, advance(pos, count),
+                                                  memory_order_relaxed))
+                return count;
+        }
+    }
+
+    //! Hands the slot at \p pos, whose element has been destroyed, back to
+    //! the producers.
+    void release_front(std::size_t pos) noexcept
+    {
+        slot(pos).sequence.store(2 * advance(pos, TSize), memory_order_release);
+    }
+
+    //! Checks if the element at the front of the buffer has not been
+    //! published yet. The result is only a snapshot. A skipped slot counts
+    //! as an element.
+    bool empty() const noexcept
+    {
+        std::size_t pos = m_head.load(memory_order_relaxed);
+        std::size_t sequence
+                = m_slots[pos % TSize].sequence.load(memory_order_acquire);
+        return distance(sequence & ~skipped_flag, 2 * pos + 1) < 0;
+    }
+
+    //! Checks if the claimed slot at \p pos has been published as skipped.
+    bool skipped(std::size_t pos) const noexcept
+    {
+        return (m_slots[pos % TSize].sequence.load(memory_order_relaxed)
+                & skipped_flag) != 0;
+    }
+
+    //! Returns a pointer to the element in the slot at \p pos.
+    TType* element(std::size_t pos) noexcept
+    {
+        return reinterpret_cast<TType*>(&slot(pos).storage);
+    }
+
+    //! Returns the position following \p pos.
+    static std::size_t next(std::size_t pos) noexcept
+    {
+        return advance(pos, 1);
+    }
+
+private:
+    struct Slot
+    {
+        atomic<std::size_t> sequence;
+        typename aligned_storage<sizeof(TType),
+                                 alignment_of<TType>::value>::type storage;
+    };
+
+    //! The positions run from 0 to (wrap - 1) and the sequences from 0 to
+    //! (2 * wrap - 1). As wrap is a multiple of the size, the slot index is
+    //! continuous when the position wraps around.
+    static const std::size_t wrap = std::size_t(-1) / 8 / TSize * TSize;
+
+    static_assert(wrap / TSize >= 2, "The size is too large.");
+
+    //! The bit of a sequence, which marks a skipped slot.
+    static const std::size_t skipped_flag = ~(std::size_t(-1) >> 1);
+
+    static std::size_t advance(std::size_t pos, std::size_t n) noexcept
+    {
+        pos += n;
+        return pos >= wrap ? pos - wrap : pos;
+    }
+
+    //! Returns the difference (a - b) of two sequences modulo (2 * wrap) as
+    //! a signed value.
+    static std::ptrdiff_t distance(std::size_t a, std::size_t b) noexcept
+    {
+        std::size_t diff = a >= b ? a - b : a + (2 * wrap - b);
+        return diff < wrap ? std::ptrdiff_t(diff)
+                           : std::ptrdiff_t(diff) - std::ptrdiff_t(2 * wrap);
+    }
+
+    Slot& slot(std::size_t pos) noexcept
+    {
+        return m_slots[pos % TSize];
+    }
+
+    //! The position from which the next element is taken. The positions
+    //! are written by different threads and are placed in their own cache
+    //! lines.
+    alignas(WEOS_CACHE_LINE_SIZE) atomic<std::size_t> m_head;
+    //! The position to which the next element is written.
+    alignas(WEOS_CACHE_LINE_SIZE) atomic<std::size_t> m_tail;
+    //! The slots for the elements.
+    alignas(WEOS_CACHE_LINE_SIZE) Slot m_slots[TSize];
+};
+
+template <typename TType, std::size_t TSize>
+const std::size_t MpmcRingBuffer<TType, TSize>::wrap;
+
+template <typename TType, std::size_t TSize>
+const std::size_t MpmcRingBuffer<TType, TSize>::skipped_flag;
+
+//! A bounded multi-producer/multi-consumer message queue.
+//! The MpmcMessageQueue stores up to (\p TQueueSize) elements inline in an
+//! MpmcRingBuffer. Sending and receiving do not need any kernel object.
+//! A thread is only blocked, if it has to wait for the queue to become
+//! non-empty (receive()) or non-full (send()). Notifying a wait queue, which
+//! is empty, costs a single load. Therefore, try_send() may be called in an
+//! interrupt context.
+//!
+//! The mix-in \p TStatistics records the occupancy and latency of the queue.
+template <typename TType, std::size_t TQueueSize,
+          typename TStatistics = NoMessageQueueStatistics>
+class MpmcMessageQueue : public TStatistics
+{
+    static_assert(TQueueSize > 0, "The queue size must be non-zero.");
+    static_assert(is_nothrow_move_constructible<TType>::value,
+                  "The type must be nothrow move-constructible.");
+
+public:
+    typedef TType value_type;
+
+    //! A reserved slot in the queue.
+    //! A reservation refers to an element, which has been constructed in a
+    //! slot of the queue but which has not been sent yet. The element can be
+    //! filled in place and is sent with commit(). A reservation, which is
+    //! destroyed without having been committed, is rolled back. Its element
+    //! is destroyed and the receivers skip the slot. Thus, an element, which
+    //! is only partially filled because an exception has been thrown, is
+    //! never sent.
+    class reservation
+    {
+    public:
+        reservation(reservation&& other) noexcept
+            : m_queue(other.m_queue),
+              m_pos(other.m_pos)
+        {
+            other.m_queue = nullptr;
+        }
+
+        ~reservation()
+        {
+            if (m_queue)
+                m_queue->skip_back(m_pos);
+        }
+
+        reservation(const reservation&) = delete;
+        reservation& operator=(const reservation&) = delete;
+
+        //! Returns the reserved element.
+        value_type& operator*() const noexcept
+        {
+            return *m_queue->m_ring.element(m_pos);
+        }
+
+        //! Returns a pointer to the reserved element.
+        value_type* operator->() const noexcept
+        {
+            return m_queue->m_ring.element(m_pos);
+        }
+
+        //! Sends the reserved element.
+        void commit() noexcept
+        {
+            if (m_queue)
+            {
+                m_queue->publish_back(m_pos);
+                m_queue = nullptr;
+            }
+        }
+
+    private:
+        reservation(MpmcMessageQueue* queue, std::size_t pos) noexcept
+            : m_queue(queue),
+              m_pos(pos)
+        {
+        }
+
+        MpmcMessageQueue* m_queue;
+        std::size_t m_pos;
+
+        friend class MpmcMessageQueue;
+    };
+
+    MpmcMessageQueue() = default;
+
+    MpmcMessageQueue(const MpmcMessageQueue&) = delete;
+    MpmcMessageQueue& operator=(const MpmcMessageQueue&) = delete;
+
+    //! \brief Receives an element from the queue.
+    //!
+    //! Returns the first element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until an element is added.
+    value_type receive()
+    {
+        std::size_t pos = claim_front();
+        value_type* element = m_ring.element(pos);
+        value_type temp(std::move(*element));
+        element->~value_type();
+        release_front(pos);
+        return temp;
+    }
+
+    //! \brief Tries to receive an element from the queue.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! non-empty, the first element is moved to \p value and \p true is
+    //! returned. Otherwise, the method returns \p false immediately.
+    bool try_receive(value_type& value)
+    {
+        std::size_t pos;
+        if (!try_claim_front_n(pos, 1))
+            return false;
+
+        // The batch releases the slot even if the assignment throws.
+        FrontBatch batch(*this, pos, 1);
+        value = std::move(batch.front());
+        return true;
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Appends the \p element to the queue. If the queue is full, the calling
+    //! thread is blocked until space becomes available.
+    void send(const value_type& element)
+    {
+        // A claimed slot must be published. If the copy could throw, it is
+        // made before a slot is claimed.
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            construct_back(claim_back(), element);
+        }
+        else
+        {
+            value_type temp(element);
+            construct_back(claim_back(), std::move(temp));
+        }
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Moves the \p element to the end of the queue. If the queue is full,
+    //! the calling thread is blocked until space becomes available.
+    void send(value_type&& element)
+    {
+        construct_back(claim_back(), std::move(element));
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to append the \p element to the queue. Returns \p true, if the
+    //! element has been added and \p false, if the queue was full.
+    bool try_send(const value_type& element)
+    {
+        std::size_t pos;
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            if (!try_claim_back(pos))
+                return false;
+            construct_back(pos, element);
+        }
+        else
+        {
+            value_type temp(element);
+            if (!try_claim_back(pos))
+                return false;
+            construct_back(pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to move the \p element to the end of the queue. Returns \p true,
+    //! if the element has been added and \p false, if the queue was full.
+    //! In the latter case, \p element is left untouched.
+    bool try_send(value_type&& element)
+    {
+        std::size_t pos;
+        if (!try_claim_back(pos))
+            return false;
+        construct_back(pos, std::move(element));
+        return true;
+    }
+
+    //! \brief Constructs an element in the queue.
+    //!
+    //! Constructs an element from the arguments \p args directly in a slot
+    //! at the end of the queue. If the queue is full, the calling thread is
+    //! blocked until space becomes available.
+    template <typename... TArgs>
+    void emplace(TArgs&&... args)
+    {
+        if (is_nothrow_constructible<value_type, TArgs&&...>::value)
+        {
+            construct_back(claim_back(), std::forward<TArgs>(args)...);
+        }
+        else
+        {
+            value_type temp(std::forward<TArgs>(args)...);
+            construct_back(claim_back(), std::move(temp));
+        }
+    }
+
+    //! \brief Tries to construct an element in the queue.
+    //!
+    //! Constructs an element from the arguments \p args directly in a slot
+    //! at the end of the queue. Returns \p false, if the queue was full.
+    //!
+    //! \note If the element's constructor may throw, the element is
+    //! constructed outside of the queue and moved to it.
+    template <typename... TArgs>
+    bool try_emplace(TArgs&&... args)
+    {
+        std::size_t pos;
+        if (is_nothrow_constructible<value_type, TArgs&&...>::value)
+        {
+            if (!try_claim_back(pos))
+                return false;
+            construct_back(pos, std::forward<TArgs>(args)...);
+        }
+        else
+        {
+            value_type temp(std::forward<TArgs>(args)...);
+            if (!try_claim_back(pos))
+                return false;
+            construct_back(pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Reserves a slot in the queue.
+    //!
+    //! Reserves a slot at the end of the queue and default-constructs an
+    //! element in it. If the queue is full, the calling thread is blocked
+    //! until space becomes available. The element can be filled in place
+    //! via the returned reservation and is sent when the reservation is
+    //! committed. If the reservation is destroyed without a commit, the
+    //! element is discarded.
+    reservation reserve()
+    {
+        static_assert(is_nothrow_default_constructible<value_type>::value,
+                      "The type must be nothrow default-constructible.");
+
+        std::size_t pos = claim_back();
+        new (m_ring.element(pos)) value_type();
+        return reservation(this, pos);
+    }
+
+    //! \brief Consumes an element in place.
+    //!
+    //! Calls \p f with a reference to the first element in the queue. The
+    //! element is destroyed and its slot is released after \p f returns. If
+    //! the queue is empty, the calling thread is blocked until an element is
+    //! added.
+    template <typename TFunction>
+    void consume(TFunction&& f)
+    {
+        std::size_t pos = claim_front();
+        FrontBatch batch(*this, pos, 1);
+        f(batch.front());
+    }
+
+    //! \brief Tries to consume an element in place.
+    //!
+    //! Calls \p f with a reference to the first element in the queue and
+    //! returns \p true. If the queue is empty, \p false is returned
+    //! immediately.
+    template <typename TFunction>
+    bool try_consume(TFunction&& f)
+    {
+        std::size_t pos;
+        if (!try_claim_front_n(pos, 1))
+            return false;
+        FrontBatch batch(*this, pos, 1);
+        f(batch.front());
+        return true;
+    }
+
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until either an element is added
+    //! or the timeout duration \p d expires. Returns \p true and moves the
+    //! element to \p value upon success.
+    template <typename TRep, typename TPeriod>
+    bool try_receive_for(value_type& value,
+                         const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_receive_until(value, chrono::steady_clock::now() + d);
+    }
+
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until either an element is added
+    //! or the point in time \p time has been reached. Returns \p true and
+    //! moves the element to \p value upon success.
+    template <typename TClock, typename TDuration>
+    bool try_receive_until(value_type& value,
+                           const chrono::time_point<TClock, TDuration>& time)
+    {
+        std::size_t pos;
+        if (!claim_front_until(pos, time))
+            return false;
+
+        FrontBatch batch(*this, pos, 1);
+        value = std::move(batch.front());
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the queue. If the queue is full,
+    //! the calling thread is blocked until either space becomes available or
+    //! the timeout duration \p d expires. Returns \p true, if the element
+    //! has been added.
+    template <typename TRep, typename TPeriod>
+    bool try_send_for(const value_type& element,
+                      const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_send_until(element, chrono::steady_clock::now() + d);
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to move the \p element to the end of the queue. If the queue is
+    //! full, the calling thread is blocked until either space becomes
+    //! available or the timeout duration \p d expires. Returns \p true, if
+    //! the element has been added. Otherwise, \p element is left untouched.
+    template <typename TRep, typename TPeriod>
+    bool try_send_for(value_type&& element,
+                      const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_send_until(std::move(element),
+                              chrono::steady_clock::now() + d);
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the queue. If the queue is full,
+    //! the calling thread is blocked until either space becomes available or
+    //! the point in time \p time has been reached. Returns \p true, if the
+    //! element has been added.
+    template <typename TClock, typename TDuration>
+    bool try_send_until(const value_type& element,
+                        const chrono::time_point<TClock, TDuration>& time)
+    {
+        std::size_t pos;
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            if (!claim_back_until(pos, time))
+                return false;
+            construct_back(pos, element);
+        }
+        else
+        {
+            value_type temp(element);
+            if (!claim_back_until(pos, time))
+                return false;
+            construct_back(pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to move the \p element to the end of the queue. If the queue is
+    //! full, the calling thread is blocked until either space becomes
+    //! available or the point in time \p time has been reached. Returns
+    //! \p true, if the element has been added. Otherwise, \p element is left
+    //! untouched.
+    template <typename TClock, typename TDuration>
+    bool try_send_until(value_type&& element,
+                        const chrono::time_point<TClock, TDuration>& time)
+    {
+        std::size_t pos;
+        if (!claim_back_until(pos, time))
+            return false;
+        construct_back(pos, std::move(element));
+        return true;
+    }
+
+    //! \brief Sends multiple elements via the queue.
+    //!
+    //! Appends the elements in the range [\p first, \p last) to the queue.
+    //! As many elements as there are free slots are claimed in a single step
+    //! and the receivers are woken once per batch. If the queue is full, the
+    //! calling thread is blocked until space becomes available.
+    template <typename TForwardIterator>
+    void send_n(TForwardIterator first, TForwardIterator last)
+    {
+        if (!is_nothrow_constructible<value_type, decltype(*first)>::value)
+        {
+            for (; first != last; ++first)
+                send(value_type(*first));
+            return;
+        }
+
+        while (first != last)
+        {
+            std::size_t pos;
+            std::size_t count = claim_back_n(pos, std::distance(first, last));
+            first = construct_back_n(pos, count, first);
+        }
+    }
+
+    //! \brief Tries to send multiple elements via the queue.
+    //!
+    //! Appends as many elements from the range [\p first, \p last) as
+    //! there are free slots in the queue. The method never blocks and
+    //! returns the number of elements which have been sent.
+    template <typename TForwardIterator>
+    std::size_t try_send_n(TForwardIterator first, TForwardIterator last)
+    {
+        std::size_t count = 0;
+        if (!is_nothrow_constructible<value_type, decltype(*first)>::value)
+        {
+            for (; first != last && try_send(value_type(*first)); ++first)
+                ++count;
+            return count;
+        }
+
+        std::size_t pos;
+        std::size_t requested = std::distance(first, last);
+        count = m_ring.try_claim_back_n(pos, requested);
+        if (count < requested)
+            this->record_send_stall();
+        if (count)
+            construct_back_n(pos, count, first);
+        return count;
+    }
+
+    //! \brief Receives multiple elements from the queue.
+    //!
+    //! Moves up to \p max elements from the queue to the output iterator
+    //! \p out and returns their number. If the queue is empty, the calling
+    //! thread is blocked until at least one element is available. All
+    //! elements which are available are claimed in a single step and the
+    //! senders are woken once per batch.
+    template <typename TOutputIterator>
+    std::size_t receive_n(TOutputIterator out, std::size_t max)
+    {
+        if (max == 0)
+            return 0;
+
+        std::size_t pos;
+        std::size_t count = claim_front_n(pos, max);
+        FrontBatch batch(*this, pos, count);
+        for (; !batch.empty(); batch.pop())
+        {
+            *out = std::move(batch.front());
+            ++out;
+        }
+        return count;
+    }
+
+    //! \brief Drains the queue.
+    //!
+    //! Takes all elements, which are currently in the queue, in a single
+    //! step and calls \p f for each of them. The element is passed as an
+    //! rvalue. The method never blocks and returns the number of elements
+    //! which have been drained.
+    template <typename TFunction>
+    std::size_t drain(TFunction&& f)
+    {
+        std::size_t pos;
+        std::size_t count = try_claim_front_n(pos, TQueueSize);
+        FrontBatch batch(*this, pos, count);
+        for (; !batch.empty(); batch.pop())
+            f(std::move(batch.front()));
+        return count;
+    }
+
+    //! Checks if an element can be received. Used by wait_any(). The slot
+    //! of a rolled back reservation makes the queue ready, too. Thus, a
+    //! subsequent try_receive() may fail.
+    friend
+    bool select_ready(const MpmcMessageQueue& queue) noexcept
+    {
+        return !queue.m_ring.empty();
+    }
+
+    //! Returns the queue of the waiting receivers. Used by wait_any().
+    friend
+    _tq& select_queue(MpmcMessageQueue& queue) noexcept
+    {
+        return queue.m_receivers;
+    }
+
+private:
+    //! A batch of claimed elements at the front of the queue. Every element
+    //! is destroyed and its slot is released, when it is popped. The
+    //! destructor releases the remaining slots, such that none gets lost if
+    //! an exception is thrown, and wakes the senders.
+    class FrontBatch
+    {
+    public:
+        FrontBatch(MpmcMessageQueue& queue, std::size_t pos,
+                   std::size_t count) noexcept
+            : m_queue(queue),
+              m_pos(pos),
+              m_count(count),
+              m_remaining(count)
+        {
+        }
+
+        ~FrontBatch()
+        {
+            while (!empty())
+                pop();
+            if (m_count > 1)
+                m_queue.m_senders.notify_all();
+            else if (m_count == 1)
+                m_queue.m_senders.notify_one();
+        }
+
+        FrontBatch(const FrontBatch&) = delete;
+        FrontBatch& operator=(const FrontBatch&) = delete;
+
+        bool empty() const noexcept
+        {
+            return m_remaining == 0;
+        }
+
+        value_type& front() noexcept
+        {
+            return *m_queue.m_ring.element(m_pos);
+        }
+
+        void pop() noexcept
+        {
+            front().~value_type();
+            m_queue.record_dequeue(m_pos);
+            m_queue.m_ring.release_front(m_pos);
+            m_pos = m_queue.m_ring.next(m_pos);
+            --m_remaining;
+        }
+
+    private:
+        MpmcMessageQueue& m_queue;
+        std::size_t m_pos;
+        std::size_t m_count;
+        std::size_t m_remaining;
+    };
+
+    //! The storage for the elements.
+    MpmcRingBuffer<value_type, TQueueSize> m_ring;
+    //! The threads which wait for an element.
+    _tq m_receivers;
+    //! The threads which wait for a free slot.
+    _tq m_senders;
+
+    //! Claims a free slot. Blocks while the queue is full.
+    std::size_t claim_back()
+    {
+        std::size_t pos;
+        claim_back_n(pos, 1);
+        return pos;
+    }
+
+    //! Tries to claim a free slot. A full queue is recorded as a stall.
+    bool try_claim_back(std::size_t& pos) noexcept
+    {
+        if (m_ring.try_claim_back(pos))
+            return true;
+        this->record_send_stall();
+        return false;
+    }
+
+    //! Claims between one and \p max free slots. Blocks while the queue
+    //! is full.
+    std::size_t claim_back_n(std::size_t& pos, std::size_t max)
+    {
+        std::size_t count = m_ring.try_claim_back_n(pos, max);
+        if (count)
+            return count;
+
+        this->record_send_stall();
+        return wait_and_claim(m_senders, [&] {
+            return m_ring.try_claim_back_n(pos, max);
+        });
+    }
+
+    //! Claims a free slot. Blocks while the queue is full but at most until
+    //! the point in time \p time.
+    template <typename TClock, typename TDuration>
+    bool claim_back_until(std::size_t& pos,
+                          const chrono::time_point<TClock, TDuration>& time)
+    {
+        if (try_claim_back(pos))
+            return true;
+        return wait_and_claim_until(m_senders, [&] {
+            return m_ring.try_claim_back_n(pos, 1);
+        }, time) != 0;
+    }
+
+    //! Tries to claim up to \p max elements at the front. The slots of
+    //! reservations, which have been rolled back, are released on the way.
+    std::size_t try_claim_front_n(std::size_t& pos, std::size_t max) noexcept
+    {
+        for (;;)
+        {
+            std::size_t count = m_ring.try_claim_front_n(pos, max);
+            if (count == 0 || !m_ring.skipped(pos))
+                return count;
+            m_ring.release_front(pos);
+            m_senders.notify_one();
+        }
+    }
+
+    //! Claims the first element. Blocks while the queue is empty.
+    std::size_t claim_front()
+    {
+        std::size_t pos;
+        claim_front_n(pos, 1);
+        return pos;
+    }
+
+    //! Claims between one and \p max elements. Blocks while the queue is
+    //! empty.
+    std::size_t claim_front_n(std::size_t& pos, std::size_t max)
+    {
+        return wait_and_claim(m_receivers, [&] {
+            return try_claim_front_n(pos, max);
+        });
+    }
+
+    //! Claims the first element. Blocks while the queue is empty but at
+    //! most until the point in time \p time.
+    template <typename TClock, typename TDuration>
+    bool claim_front_until(std::size_t& pos,
+                           const chrono::time_point<TClock, TDuration>& time)
+    {
+        return wait_and_claim_until(m_receivers, [&] {
+            return try_claim_front_n(pos, 1);
+        }, time) != 0;
+    }
+
+    //! Constructs an element from \p args in the claimed slot at \p pos
+    //! and wakes a receiver.
+    template <typename... TArgs>
+    void construct_back(std::size_t pos, TArgs&&... args) noexcept
+    {
+        new (m_ring.element(pos)) value_type(std::forward<TArgs>(args)...);
+        publish_back(pos);
+    }
+
+    //! Publishes the element in the slot at \p pos and wakes a receiver.
+    void publish_back(std::size_t pos) noexcept
+    {
+        this->record_enqueue(pos);
+        m_ring.publish_back(pos);
+        m_receivers.notify_one();
+    }
+
+    //! Destroys the element in the claimed slot at \p pos and publishes the
+    //! slot as skipped. A receiver is woken, because it may be waiting for
+    //! an element behind this slot.
+    void skip_back(std::size_t pos) noexcept
+    {
+        m_ring.element(pos)->~value_type();
+        m_ring.publish_skipped_back(pos);
+        m_receivers.notify_one();
+    }
+
+    //! Constructs \p count elements from the range starting at \p first in
+    //! the claimed slots starting at \p pos and wakes the receivers. Returns
+    //! the iterator past the last element, which has been used.
+    template <typename TForwardIterator>
+    TForwardIterator construct_back_n(std::size_t pos, std::size_t count,
+                                      TForwardIterator first) noexcept
+    {
+        for (std::size_t idx = 0; idx < count; ++idx, ++first)
+        {
+            new (m_ring.element(pos)) value_type(*first);
+            this->record_enqueue(pos);
+            m_ring.publish_back(pos);
+            pos = m_ring.next(pos);
+        }
+        if (count > 1)
+            m_receivers.notify_all();
+        else
+            m_receivers.notify_one();
+        return first;
+    }
+
+    //! Releases the slot at \p pos after its element has been destroyed and
+    //! wakes a sender.
+    void release_front(std::size_t pos) noexcept
+    {
+        this->record_dequeue(pos);
+        m_ring.release_front(pos);
+        m_senders.notify_one();
+    }
+};
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_MPMCMESSAGEQUEUE_HPP
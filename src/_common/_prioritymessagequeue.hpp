@@ -0,0 +1,506 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_PRIORITYMESSAGEQUEUE_HPP
+#define WEOS_COMMON_PRIORITYMESSAGEQUEUE_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+// The wait queue (weos_detail::_tq) is provided by the backend, which has
+// to include its _tq.hpp before this file.
+#include "_bitops.hpp"
+#include "_mpmcmessagequeue.hpp"
+#include "../atomic.hpp"
+#include "../chrono.hpp"
+#include "../type_traits.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A message queue with priorities.
+//! The priority_message_queue sorts the elements into (\p TLevels) priority
+//! levels, where a higher level is more urgent. Within a level, the elements
+//! are passed in FIFO order but a receiver always gets an element from the
+//! highest non-empty level. Every level is an MPMC ring buffer with
+//! (\p TQueueSize) slots and its own queue of waiting senders. Thus, sending
+//! to a full level does not block the senders of other levels. The
+//! receivers share a single wait queue for all levels.
+//!
+//! A bitmap marks the levels which may hold an element. The receiver finds
+//! the highest of them in constant time by counting the leading zeros.
+//! The bitmap is updated lazily. A bit is set after an element has been
+//! sent and is only cleared by a receiver, which finds the level empty.
+template <typename TType, std::size_t TQueueSize, unsigned TLevels>
+class priority_message_queue
+{
+    static_assert(TLevels > 0 && TLevels <= 32,
+                  "The number of levels must be between 1 and 32.");
+    static_assert(is_nothrow_move_constructible<TType>::value,
+                  "The type must be nothrow move-constructible.");
+
+public:
+    typedef TType value_type;
+
+    priority_message_queue() noexcept
+        : m_nonEmptyLevels(0)
+    {
+    }
+
+    priority_message_queue(const priority_message_queue&) = delete;
+    priority_message_queue& operator=(const priority_message_queue&) = delete;
+
+    //! \brief Returns the capacity of a level.
+    //!
+    //! Returns the maximum number of elements which every priority level
+    //! can hold.
+    std::size_t capacity() const noexcept
+    {
+        return TQueueSize;
+    }
+
+    //! \brief Returns the number of priority levels.
+    unsigned levels() const noexcept
+    {
+        return TLevels;
+    }
+
+    //! \brief Receives an element from the queue.
+    //!
+    //! Returns the first element of the highest non-empty priority level.
+    //! If the queue is empty, the calling thread is blocked until an element
+    //! is added.
+    value_type receive()
+    {
+        typename aligned_storage<sizeof(value_type),
+                                 alignment_of<value_type>::value>::type storage;
+        consume([&](value_type& element) {
+            new (&storage) value_type(std::move(element));
+        });
+
+        value_type* element = static_cast<value_type*>(
+                                  static_cast<void*>(&storage));
+        value_type temp(std::move(*element));
+        element->~value_type();
+        return temp;
+    }
+
+    //! \brief Tries to receive an element from the queue.
+    //!
+    //! Tries to receive an element from the highest non-empty priority
+    //! level. If there is such an element, it is moved to \p value and
+    //! \p true is returned. Otherwise, the method returns \p false
+    //! immediately.
+    bool try_receive(value_type& value)
+    {
+        return try_consume([&](value_type& element) {
+            value = std::move(element);
+        });
+    }
+
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the highest non-empty priority
+    //! level. If the queue is empty, the calling thread is blocked until
+    //! either an element is added or the timeout duration \p d expires.
+    //! Returns \p true and moves the element to \p value upon success.
+    template <typename TRep, typename TPeriod>
+    bool try_receive_for(value_type& value,
+                         const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_receive_until(value, chrono::steady_clock::now() + d);
+    }
+
+    //! \brief Tries to receive an element from the queue with a timeout.
+    //!
+    //! Tries to receive an element from the highest non-empty priority
+    //! level. If the queue is empty, the calling thread is blocked until
+    //! either an element is added or the point in time \p time has been
+    //! reached. Returns \p true and moves the element to \p value upon
+    //! success.
+    template <typename TClock, typename TDuration>
+    bool try_receive_until(value_type& value,
+                           const chrono::time_point<TClock, TDuration>& time)
+    {
+        auto f = [&](value_type& element) {
+            value = std::move(element);
+        };
+        return weos_detail::wait_and_claim_until(m_receivers, [&] {
+            return std::size_t(consume_highest(f));
+        }, time) != 0;
+    }
+
+    //! \brief Consumes an element in place.
+    //!
+    //! Calls \p f with a reference to the first element of the highest
+    //! non-empty priority level. The element is destroyed after \p f
+    //! returns. If the queue is empty, the calling thread is blocked until
+    //! an element is added.
+    template <typename TFunction>
+    void consume(TFunction&& f)
+    {
+        weos_detail::wait_and_claim(m_receivers, [&] {
+            return std::size_t(consume_highest(f));
+        });
+    }
+
+    //! \brief Tries to consume an element in place.
+    //!
+    //! Calls \p f with a reference to the first element of the highest
+    //! non-empty priority level and returns \p true. If the queue is empty,
+    //! \p false is returned immediately.
+    template <typename TFunction>
+    bool try_consume(TFunction&& f)
+    {
+        return consume_highest(f);
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Appends the \p element to the given \p priority level. If this level
+    //! is full, the calling thread is blocked until space becomes available.
+    void send(const value_type& element, unsigned priority = 0)
+    {
+        // A claimed slot must be published. If the copy could throw, it is
+        // made before a slot is claimed.
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            construct_back(priority, claim_back(priority), element);
+        }
+        else
+        {
+            value_type temp(element);
+            construct_back(priority, claim_back(priority), std::move(temp));
+        }
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Moves the \p element to the end of the given \p priority level. If
+    //! this level is full, the calling thread is blocked until space becomes
+    //! available.
+    void send(value_type&& element, unsigned priority = 0)
+    {
+        construct_back(priority, claim_back(priority), std::move(element));
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to append the \p element to the given \p priority level. If
+    //! this level is full, \p false is returned immediately.
+    //!
+    //! \note This method may be called in an interrupt context.
+    bool try_send(const value_type& element, unsigned priority = 0)
+    {
+        std::size_t pos;
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            if (!level(priority).try_claim_back(pos))
+                return false;
+            construct_back(priority, pos, element);
+        }
+        else
+        {
+            value_type temp(element);
+            if (!level(priority).try_claim_back(pos))
+                return false;
+            construct_back(priority, pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to move the \p element to the end of the given \p priority
+    //! level. If this level is full, \p false is returned immediately and
+    //! \p element is left untouched.
+    //!
+    //! \note This method may be called in an interrupt context.
+    bool try_send(value_type&& element, unsigned priority = 0)
+    {
+        std::size_t pos;
+        if (!level(priority).try_claim_back(pos))
+            return false;
+        construct_back(priority, pos, std::move(element));
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the given \p priority level. If
+    //! this level is full, the calling thread is blocked until either space
+    //! becomes available or the timeout duration \p d expires. Returns
+    //! \p true, if the element has been added.
+    template <typename TRep, typename TPeriod>
+    bool try_send_for(const value_type& element,
+                      const chrono::duration<TRep, TPeriod>& d,
+                      unsigned priority = 0)
+    {
+        return try_send_until(element, chrono::steady_clock::now() + d,
+                              priority);
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to move the \p element to the end of the given \p priority
+    //! level. If this level is full, the calling thread is blocked until
+    //! either space becomes available or the timeout duration \p d expires.
+    //! Returns \p true, if the element has been added. Otherwise,
+    //! \p element is left untouched.
+    template <typename TRep, typename TPeriod>
+    bool try_send_for(value_type&& element,
+                      const chrono::duration<TRep, TPeriod>& d,
+                      unsigned priority = 0)
+    {
+        return try_send_until(std::move(element),
+                              chrono::steady_clock::now() + d, priority);
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to append the \p element to the given \p priority level. If
+    //! this level is full, the calling thread is blocked until either space
+    //! becomes available or the point in time \p time has been reached.
+    //! Returns \p true, if the element has been added.
+    template <typename TClock, typename TDuration>
+    bool try_send_until(const value_type& element,
+                        const chrono::time_point<TClock, TDuration>& time,
+                        unsigned priority = 0)
+    {
+        std::size_t pos;
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            if (!claim_back_until(priority, pos, time))
+                return false;
+            construct_back(priority, pos, element);
+        }
+        else
+        {
+            value_type temp(element);
+            if (!claim_back_until(priority, pos, time))
+                return false;
+            construct_back(priority, pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue with a timeout.
+    //!
+    //! Tries to move the \p element to the end of the given \p priority
+    //! level. If this level is full, the calling thread is blocked until
+    //! either space becomes available or the point in time \p time has been
+    //! reached. Returns \p true, if the element has been added. Otherwise,
+    //! \p element is left untouched.
+    template <typename TClock, typename TDuration>
+    bool try_send_until(value_type&& element,
+                        const chrono::time_point<TClock, TDuration>& time,
+                        unsigned priority = 0)
+    {
+        std::size_t pos;
+        if (!claim_back_until(priority, pos, time))
+            return false;
+        construct_back(priority, pos, std::move(element));
+        return true;
+    }
+
+    //! Checks if an element can be received. Used by wait_any().
+    friend
+    bool select_ready(const priority_message_queue& queue) noexcept
+    {
+        for (const ring_type& level : queue.m_levels)
+            if (!level.empty())
+                return true;
+        return false;
+    }
+
+    //! Returns the queue of the waiting receivers. Used by wait_any().
+    friend
+    weos_detail::_tq& select_queue(priority_message_queue& queue) noexcept
+    {
+        return queue.m_receivers;
+    }
+
+private:
+    typedef weos_detail::MpmcRingBuffer<value_type, TQueueSize> ring_type;
+
+    //! A claimed element at the front of a level. The destructor destroys
+    //! the element, releases its slot and wakes a sender of the level, also
+    //! if an exception has been thrown while the element was consumed.
+    class FrontSlot
+    {
+    public:
+        FrontSlot(priority_message_queue& queue, unsigned priority,
+                  std::size_t pos) noexcept
+            : m_queue(queue),
+              m_priority(priority),
+              m_pos(pos)
+        {
+        }
+
+        ~FrontSlot()
+        {
+            ring_type& level = m_queue.m_levels[m_priority];
+            level.element(m_pos)->~value_type();
+            level.release_front(m_pos);
+            m_queue.m_senders[m_priority].notify_one();
+        }
+
+        FrontSlot(const FrontSlot&) = delete;
+        FrontSlot& operator=(const FrontSlot&) = delete;
+
+        value_type& element() noexcept
+        {
+            return *m_queue.m_levels[m_priority].element(m_pos);
+        }
+
+    private:
+        priority_message_queue& m_queue;
+        unsigned m_priority;
+        std::size_t m_pos;
+    };
+
+    //! The elements of every priority level.
+    ring_type m_levels[TLevels];
+    //! The threads which wait for a free slot. There is one queue per
+    //! level. The queues are kept apart from the ring buffers, which are
+    //! padded to whole cache lines.
+    weos_detail::_tq m_senders[TLevels];
+    //! A bitmap of the levels which may be non-empty. Bit i is set, if
+    //! level i may hold an element.
+    atomic<std::uint32_t> m_nonEmptyLevels;
+    //! The threads which wait for an element in any level.
+    weos_detail::_tq m_receivers;
+
+    ring_type& level(unsigned priority) noexcept
+    {
+        WEOS_ASSERT(priority < TLevels);
+        return m_levels[priority];
+    }
+
+    //! Claims a free slot in the level \p priority. Blocks while this level
+    //! is full.
+    std::size_t claim_back(unsigned priority)
+    {
+        std::size_t pos;
+        weos_detail::wait_and_claim(m_senders[priority], [&] {
+            return level(priority).try_claim_back(pos);
+        });
+        return pos;
+    }
+
+    //! Claims a free slot in the level \p priority. Blocks while this level
+    //! is full but at most until the point in time \p time.
+    template <typename TClock, typename TDuration>
+    bool claim_back_until(unsigned priority, std::size_t& pos,
+                          const chrono::time_point<TClock, TDuration>& time)
+    {
+        return weos_detail::wait_and_claim_until(m_senders[priority], [&] {
+            return level(priority).try_claim_back(pos);
+        }, time);
+    }
+
+    //! Constructs an element from \p args in the claimed slot at \p pos of
+    //! the level \p priority and publishes it.
+    template <typename... TArgs>
+    void construct_back(unsigned priority, std::size_t pos,
+                        TArgs&&... args) noexcept
+    {
+        new (m_levels[priority].element(pos))
+                value_type(std::forward<TArgs>(args)...);
+        m_levels[priority].publish_back(pos);
+        announce(priority);
+    }
+
+    //! Calls \p f for the first element of the level \p priority. Returns
+    //! \p false, if the level is empty.
+    template <typename TFunction>
+    bool try_consume(unsigned priority, TFunction& f)
+    {
+        std::size_t pos;
+        if (!m_levels[priority].try_claim_front(pos))
+            return false;
+        FrontSlot slot(*this, priority, pos);
+        f(slot.element());
+        return true;
+    }
+
+    //! Marks the level \p priority as non-empty after an element has been
+    //! sent to it and wakes a receiver.
+    void announce(unsigned priority) noexcept
+    {
+        m_nonEmptyLevels.fetch_or(std::uint32_t(1) << priority,
+                                  memory_order_release);
+        m_receivers.notify_one();
+    }
+
+    //! Calls \p f for the first element of the highest non-empty level.
+    //! Returns \p false, if all levels are empty.
+    template <typename TFunction>
+    bool consume_highest(TFunction& f)
+    {
+        for (;;)
+        {
+            std::uint32_t nonEmpty
+                    = m_nonEmptyLevels.load(memory_order_acquire);
+            if (nonEmpty == 0)
+                return false;
+
+            unsigned priority = 31 - weos_detail::count_leading_zeros(nonEmpty);
+            if (try_consume(priority, f))
+                return true;
+
+            // The level looks empty. Clear its bit and look once more. A
+            // sender, which has set the bit before, has also published its
+            // element, which is found now. A sender, which comes later,
+            // sets the bit again.
+            std::uint32_t bit = std::uint32_t(1) << priority;
+            m_nonEmptyLevels.fetch_and(~bit, memory_order_acq_rel);
+            if (try_consume(priority, f))
+            {
+                // More elements may follow in this level. Restore the bit and
+                // pass on the notification, which another receiver might
+                // have consumed while the bit was clear.
+                m_nonEmptyLevels.fetch_or(bit, memory_order_release);
+                m_receivers.notify_one();
+                return true;
+            }
+        }
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_PRIORITYMESSAGEQUEUE_HPP
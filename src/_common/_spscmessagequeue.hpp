@@ -0,0 +1,406 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_SPSCMESSAGEQUEUE_HPP
+#define WEOS_COMMON_SPSCMESSAGEQUEUE_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+// The wait queue (weos_detail::_tq) is provided by the backend, which has
+// to include its _tq.hpp before this file.
+#include "../atomic.hpp"
+#include "../type_traits.hpp"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! A single-producer/single-consumer ring buffer.
+//! The SpscRingBuffer stores up to (\p TSize) elements of type \p TType
+//! inline. Only one thread may write to the buffer and only one thread may
+//! read from it at the same time. Both operations are wait-free.
+//!
+//! The head and the tail position run from 0 to (2 * TSize - 1). Thus, a
+//! full buffer can be told apart from an empty one without wasting a slot.
+//! Each side keeps a cached copy of the other side's position in its own
+//! cache line and only reloads it, when the buffer looks full or empty.
+//!
+//! Like the MpmcRingBuffer, claiming a slot and filling (or emptying) it are
+//! separate steps.
+template <typename TType, std::size_t TSize>
+class SpscRingBuffer
+{
+    static_assert(TSize > 0, "The size must be non-zero.");
+
+public:
+    SpscRingBuffer() noexcept
+        : m_tail(0),
+          m_cachedHead(0),
+          m_head(0),
+          m_cachedTail(0),
+          m_uninitialized()
+    {
+    }
+
+    //! Destroys the elements which are still in the buffer.
+    ~SpscRingBuffer()
+    {
+        std::size_t pos;
+        while (try_claim_front(pos))
+        {
+            element(pos)->~TType();
+            release_front(pos);
+        }
+    }
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    //! Claims the free slot at the back of the buffer. Returns \p true and
+    //! the slot's position in \p pos, if the buffer was not full. Must only
+    //! be called by the producer.
+    bool try_claim_back(std::size_t& pos) noexcept
+    {
+        pos = m_tail.load(memory_order_relaxed);
+        if (distance(pos, m_cachedHead) == TSize)
+        {
+            m_cachedHead = m_head.load(memory_order_acquire);
+            if (distance(pos, m_cachedHead) == TSize)
+                return false;
+        }
+        return true;
+    }
+
+    //! Hands the element in the slot at \p pos over to the consumer.
+    void publish_back(std::size_t pos) noexcept
+    {
+        m_tail.store(advance(pos), memory_order_release);
+    }
+
+    //! Claims the element at the front of the buffer. Returns \p true and
+    //! the slot's position in \p pos, if the buffer was not empty. Must only
+    //! be called by the consumer.
+    bool try_claim_front(std::size_t& pos) noexcept
+    {
+        pos = m_head.load(memory_order_relaxed);
+        if (pos == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(memory_order_acquire);
+            if (pos == m_cachedTail)
+                return false;
+        }
+        return true;
+    }
+
+    //! Hands the slot at \p pos, whose element has been destroyed, back to
+    //! the producer.
+    void release_front(std::size_t pos) noexcept
+    {
+        m_head.store(advance(pos), memory_order_release);
+    }
+
+    //! Checks if the buffer is empty. Must only be called by the consumer.
+    bool empty() const noexcept
+    {
+        return m_head.load(memory_order_relaxed)
+               == m_tail.load(memory_order_acquire);
+    }
+
+    //! Returns a pointer to the element in the slot at \p pos.
+    TType* element(std::size_t pos) noexcept
+    {
+        return reinterpret_cast<TType*>(&m_slots[pos < TSize ? pos : pos - TSize]);
+    }
+
+private:
+    typedef typename aligned_storage<sizeof(TType),
+                                     alignment_of<TType>::value>::type slot_type;
+
+    static std::size_t advance(std::size_t pos) noexcept
+    {
+        return pos + 1 == 2 * TSize ? 0 : pos + 1;
+    }
+
+    //! Returns the number of elements between the \p head and the \p tail.
+    static std::size_t distance(std::size_t tail, std::size_t head) noexcept
+    {
+        return tail >= head ? tail - head : tail + 2 * TSize - head;
+    }
+
+    //! The position to which the producer writes the next element.
+    alignas(WEOS_CACHE_LINE_SIZE) atomic<std::size_t> m_tail;
+    //! The producer's copy of the head.
+    std::size_t m_cachedHead;
+    //! The position from which the consumer takes the next element.
+    alignas(WEOS_CACHE_LINE_SIZE) atomic<std::size_t> m_head;
+    //! The consumer's copy of the tail.
+    std::size_t m_cachedTail;
+    //! The slots for the elements. The constructor initializes the dummy
+    //! instead of the slots, so that the slots are not filled at run-time.
+    union
+    {
+        char m_uninitialized;
+        alignas(WEOS_CACHE_LINE_SIZE) slot_type m_slots[TSize];
+    };
+};
+
+} // namespace weos_detail
+
+//! A single-producer/single-consumer message queue.
+//! The spsc_message_queue passes elements from exactly one sending thread
+//! to exactly one receiving thread. The sender and the receiver may change
+//! over time but there must never be two concurrent senders or two
+//! concurrent receivers. try_send() may be called in an interrupt context.
+//!
+//! The elements are stored inline in a wait-free ring buffer. In contrast
+//! to the message_queue, sending and receiving do not involve the kernel
+//! at all, unless the peer is blocked (or has to block) on an empty or
+//! full queue.
+template <typename TType, std::size_t TQueueSize>
+class spsc_message_queue
+{
+    static_assert(TQueueSize > 0, "The queue size must be non-zero.");
+    static_assert(is_nothrow_move_constructible<TType>::value,
+                  "The type must be nothrow move-constructible.");
+
+public:
+    //! The type of the elements transfered via this message queue.
+    typedef TType value_type;
+
+    //! \brief Creates a message queue.
+    //!
+    //! Creates an empty message queue.
+    spsc_message_queue() = default;
+
+    spsc_message_queue(const spsc_message_queue&) = delete;
+    spsc_message_queue& operator=(const spsc_message_queue&) = delete;
+
+    //! \brief Returns the capacity.
+    //!
+    //! Returns the maximum number of elements which the queue can hold.
+    std::size_t capacity() const noexcept
+    {
+        return TQueueSize;
+    }
+
+    //! \brief Receives an element from the queue.
+    //!
+    //! Returns the first element from the message queue. If the queue is
+    //! empty, the calling thread is blocked until an element is added.
+    value_type receive()
+    {
+        std::size_t pos = claim_front();
+        value_type* element = m_ring.element(pos);
+        value_type temp(std::move(*element));
+        element->~value_type();
+        release_front(pos);
+        return temp;
+    }
+
+    //! \brief Tries to receive an element from the queue.
+    //!
+    //! Tries to receive an element from the message queue. If the queue is
+    //! non-empty, the first element is moved to \p value and \p true is
+    //! returned. Otherwise, the method returns \p false immediately.
+    bool try_receive(value_type& value)
+    {
+        std::size_t pos;
+        if (!m_ring.try_claim_front(pos))
+            return false;
+
+        // The slot is released even if the assignment throws.
+        struct Release
+        {
+            ~Release()
+            {
+                m_queue.m_ring.element(m_pos)->~value_type();
+                m_queue.release_front(m_pos);
+            }
+
+            spsc_message_queue& m_queue;
+            std::size_t m_pos;
+        } release{*this, pos};
+
+        value = std::move(*m_ring.element(pos));
+        return true;
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Appends the \p element to the queue. If the queue is full, the calling
+    //! thread is blocked until space becomes available.
+    void send(const value_type& element)
+    {
+        // A claimed slot must be published. If the copy could throw, it is
+        // made before a slot is claimed.
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            construct_back(claim_back(), element);
+        }
+        else
+        {
+            value_type temp(element);
+            construct_back(claim_back(), std::move(temp));
+        }
+    }
+
+    //! \brief Sends an element via the queue.
+    //!
+    //! Moves the \p element to the end of the queue. If the queue is full,
+    //! the calling thread is blocked until space becomes available.
+    void send(value_type&& element)
+    {
+        construct_back(claim_back(), std::move(element));
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to append the \p element to the queue. Returns \p true, if the
+    //! element has been added and \p false, if the queue was full.
+    //!
+    //! \note This method may be called in an interrupt context.
+    bool try_send(const value_type& element)
+    {
+        std::size_t pos;
+        if (is_nothrow_copy_constructible<value_type>::value)
+        {
+            if (!m_ring.try_claim_back(pos))
+                return false;
+            construct_back(pos, element);
+        }
+        else
+        {
+            value_type temp(element);
+            if (!m_ring.try_claim_back(pos))
+                return false;
+            construct_back(pos, std::move(temp));
+        }
+        return true;
+    }
+
+    //! \brief Tries to send an element via the queue.
+    //!
+    //! Tries to move the \p element to the end of the queue. Returns \p true,
+    //! if the element has been added and \p false, if the queue was full.
+    //! In the latter case, \p element is left untouched.
+    //!
+    //! \note This method may be called in an interrupt context.
+    bool try_send(value_type&& element)
+    {
+        std::size_t pos;
+        if (!m_ring.try_claim_back(pos))
+            return false;
+        construct_back(pos, std::move(element));
+        return true;
+    }
+
+    //! Checks if an element can be received. Used by wait_any(), which
+    //! must only be called by the receiver.
+    friend
+    bool select_ready(const spsc_message_queue& queue) noexcept
+    {
+        return !queue.m_ring.empty();
+    }
+
+    //! Returns the queue of the waiting receiver. Used by wait_any().
+    friend
+    weos_detail::_tq& select_queue(spsc_message_queue& queue) noexcept
+    {
+        return queue.m_receivers;
+    }
+
+private:
+    //! The storage for the elements.
+    weos_detail::SpscRingBuffer<value_type, TQueueSize> m_ring;
+    //! The receiver, if it waits for an element.
+    weos_detail::_tq m_receivers;
+    //! The sender, if it waits for a free slot.
+    weos_detail::_tq m_senders;
+
+    //! Claims a free slot. Blocks while the queue is full.
+    std::size_t claim_back()
+    {
+        std::size_t pos;
+        while (!m_ring.try_claim_back(pos))
+        {
+            // Link into the wait queue before re-checking the ring buffer.
+            // Then a slot which is released in between cannot be missed.
+            weos_detail::_tq::_t t(m_senders);
+            if (m_ring.try_claim_back(pos))
+                break;
+            t.wait();
+        }
+        return pos;
+    }
+
+    //! Claims the first element. Blocks while the queue is empty.
+    std::size_t claim_front()
+    {
+        std::size_t pos;
+        while (!m_ring.try_claim_front(pos))
+        {
+            weos_detail::_tq::_t t(m_receivers);
+            if (m_ring.try_claim_front(pos))
+                break;
+            t.wait();
+        }
+        return pos;
+    }
+
+    //! Constructs an element from \p arg in the claimed slot at \p pos and
+    //! wakes the receiver, if it is blocked.
+    template <typename TArg>
+    void construct_back(std::size_t pos, TArg&& arg) noexcept
+    {
+        new (m_ring.element(pos)) value_type(std::forward<TArg>(arg));
+        m_ring.publish_back(pos);
+        m_receivers.notify_one();
+    }
+
+    //! Releases the slot at \p pos after its element has been destroyed and
+    //! wakes the sender, if it is blocked.
+    void release_front(std::size_t pos) noexcept
+    {
+        m_ring.release_front(pos);
+        m_senders.notify_one();
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_SPSCMESSAGEQUEUE_HPP
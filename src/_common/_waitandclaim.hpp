@@ -0,0 +1,114 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_COMMON_WAITANDCLAIM_HPP
+#define WEOS_COMMON_WAITANDCLAIM_HPP
+
+
+#ifndef WEOS_CONFIG_HPP
+    #error "Do not include this file directly."
+#endif // WEOS_CONFIG_HPP
+
+
+// The wait queue (weos_detail::_tq) is provided by the backend, which has
+// to include its _tq.hpp before this file.
+#include "../chrono.hpp"
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! Calls \p claim until it succeeds and returns its result. \p claim returns
+//! a value, which converts to \p false upon failure (e.g. a number of slots
+//! or a pointer to a chunk). In between, the thread waits on the queue \p q.
+template <typename TClaim>
+auto wait_and_claim(_tq& q, TClaim claim) -> decltype(claim())
+{
+    decltype(claim()) result = claim();
+    if (result)
+        return result;
+
+    for (;;)
+    {
+        // Link into the wait queue before re-checking the resource. Then a
+        // release in between cannot be missed.
+        _tq::_t t(q);
+        if ((result = claim()))
+            break;
+        t.wait();
+    }
+
+    // A thread can be woken for a resource, which another thread takes
+    // first, or it can succeed on the re-check after it has been notified.
+    // In both cases, the notification of another thread would be consumed.
+    // Therefore, it is passed on by every thread, which has been linked.
+    q.notify_one();
+    return result;
+}
+
+//! Calls \p claim until it succeeds or the point in time \p time has been
+//! reached. In between, the thread waits on the queue \p q. Returns the
+//! result of the last call to \p claim.
+template <typename TClaim, typename TClock, typename TDuration>
+auto wait_and_claim_until(_tq& q, TClaim claim,
+                          const chrono::time_point<TClock, TDuration>& time)
+    -> decltype(claim())
+{
+    decltype(claim()) result = claim();
+    if (result)
+        return result;
+
+    for (;;)
+    {
+        _tq::_t t(q);
+        if ((result = claim()))
+            break;
+        if (!t.wait_until(time))
+        {
+            // Unlink before the final check, such that no notification
+            // is sent to this thread when it has given up.
+            bool notified = t.unlink();
+            if ((result = claim()))
+                break;
+            if (notified)
+                q.notify_one();
+            return result;
+        }
+    }
+
+    q.notify_one();
+    return result;
+}
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_COMMON_WAITANDCLAIM_HPP
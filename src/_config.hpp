@@ -139,6 +139,21 @@
 #endif // WEOS_ENABLE_EXCEPTIONS
 
 
+// ----=====================================================================----
+//     Cache line size
+// ----=====================================================================----
+
+// The Cortex-M cores, on which CMSIS-RTOS runs, have no data cache. Padding
+// to a cache line would only waste RAM, so the pointer alignment is used.
+#if !defined(WEOS_CACHE_LINE_SIZE)
+    #if defined(WEOS_WRAP_CMSIS_RTOS)
+        #define WEOS_CACHE_LINE_SIZE   alignof(void*)
+    #else
+        #define WEOS_CACHE_LINE_SIZE   64
+    #endif
+#endif // WEOS_CACHE_LINE_SIZE
+
+
 // ----=====================================================================----
 //     Compiler specifica
 // ----=====================================================================----
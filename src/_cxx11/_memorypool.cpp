@@ -0,0 +1,90 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "_memorypool.hpp"
+
+#include <limits>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+namespace
+{
+
+// A bit mask of the thread cache indices which are in use.
+atomic<std::uint32_t> g_usedThreadCacheIndices(0);
+
+// Acquires a thread cache index upon construction and releases it again
+// when the thread exits.
+struct ThreadCacheIndex
+{
+    ThreadCacheIndex() noexcept
+        : index(std::numeric_limits<std::size_t>::max())
+    {
+        std::uint32_t used = g_usedThreadCacheIndices.load();
+        for (;;)
+        {
+            if (used == ~std::uint32_t(0))
+                return;
+
+            std::size_t free = 0;
+            while (used & (std::uint32_t(1) << free))
+                ++free;
+
+            if (g_usedThreadCacheIndices.compare_exchange_weak(
+                    used, used | (std::uint32_t(1) << free)))
+            {
+                index = free;
+                return;
+            }
+        }
+    }
+
+    ~ThreadCacheIndex()
+    {
+        if (index < 32)
+            g_usedThreadCacheIndices.fetch_and(~(std::uint32_t(1) << index));
+    }
+
+    std::size_t index;
+};
+
+} // anonymous namespace
+
+std::size_t thread_cache_index() noexcept
+{
+    static thread_local ThreadCacheIndex cacheIndex;
+    return cacheIndex.index;
+}
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
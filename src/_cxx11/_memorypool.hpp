@@ -0,0 +1,669 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_MEMORYPOOL_HPP
+#define WEOS_CXX11_MEMORYPOOL_HPP
+
+#include "_core.hpp"
+
+#include "_tq.hpp"
+
+#include "../memorypool.hpp"
+#include "../_common/_waitandclaim.hpp"
+#include "../atomic.hpp"
+#include "../chrono.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! A lock-free free-list.
+//! The SharedFreeList is a Treiber stack of memory chunks, which can be
+//! accessed concurrently from multiple threads without locking. Like the
+//! FreeList, it stores the pointer to the next free chunk in the first bytes
+//! of every chunk.
+//!
+//! In order to prevent the ABA problem, the head of the stack is a 64-bit
+//! word, which combines the offset of the first chunk relative to the start
+//! of the memory (plus one, such that an empty stack has a zero offset) with
+//! a tag. The tag is incremented with every modification
+//! of the head. Thus, a compare-and-swap fails if the stack has been changed
+//! in the mean time even if the same chunk is at the top again. As a
+//! consequence, a whole chain of chunks can be taken from or put onto the
+//! stack with a single compare-and-swap.
+//!
+//! Like the FreeList, the stack starts empty and the chunks, which have never
+//! been allocated, are handed out by atomically incrementing a bump index.
+//! Therefore, the constructor runs in constant time and is a constant
+//! expression. Like the FreeList, the stack is passed the chunks with every
+//! call and its initial value is all zero bits.
+class SharedFreeList
+{
+public:
+    constexpr SharedFreeList() noexcept
+        : m_head(0),
+          m_bump(0)
+    {
+    }
+
+    SharedFreeList(const SharedFreeList&) = delete;
+    SharedFreeList& operator=(const SharedFreeList&) = delete;
+
+    bool empty(const ChunkArray& array) const noexcept
+    {
+        return offset(m_head.load(memory_order_relaxed)) == 0
+               && m_bump.load(memory_order_relaxed) == array.numChunks;
+    }
+
+    void* try_allocate(const ChunkArray& array) noexcept
+    {
+        std::uint64_t head = m_head.load(memory_order_acquire);
+        for (;;)
+        {
+            void* chunk = pointer(array, head);
+            if (chunk == 0)
+            {
+                void* chunks[1];
+                return try_bump_n(array, chunks, 1) != 0 ? chunks[0] : 0;
+            }
+
+            // The chunk might have been allocated by another thread in the
+            // mean time and its content may be garbage now. This is
+            // harmless because the compare-and-swap fails in this case as
+            // the tag has been changed.
+            void* nextChunk = chunk_link(chunk);
+            if (m_head.compare_exchange_weak(head,
+                                             pack(array, nextChunk,
+                                                  tag(head) + 1),
+                                             memory_order_acquire,
+                                             memory_order_acquire))
+            {
+                return chunk;
+            }
+        }
+    }
+
+    void free(const ChunkArray& array, void* chunk) noexcept
+    {
+        std::uint64_t head = m_head.load(memory_order_relaxed);
+        do
+        {
+            chunk_link(chunk) = pointer(array, head);
+        } while (!m_head.compare_exchange_weak(head,
+                                               pack(array, chunk, tag(head) + 1),
+                                               memory_order_release,
+                                               memory_order_relaxed));
+    }
+
+    //! Allocates up to \p n chunks and stores them in \p chunks. The chunks
+    //! are unlinked from the list with a single compare-and-swap. Returns
+    //! the number of chunks which have been allocated.
+    std::size_t try_allocate_n(const ChunkArray& array, void** chunks,
+                               std::size_t n) noexcept
+    {
+        std::uint64_t head = m_head.load(memory_order_acquire);
+        for (;;)
+        {
+            // Walk along the chain. As in try_allocate(), the chunks may be
+            // modified concurrently. Stop as soon as a link does not point
+            // into the managed memory - the compare-and-swap will fail anyway.
+            std::size_t count = 0;
+            void* iter = pointer(array, head);
+            while (iter != 0 && count < n)
+            {
+                chunks[count++] = iter;
+                iter = chunk_link(iter);
+                if (iter != 0 && !contains(array, iter))
+                    break;
+            }
+
+            if (count == 0)
+                return try_bump_n(array, chunks, n);
+
+            if (iter == 0 || contains(array, iter))
+            {
+                if (m_head.compare_exchange_weak(head,
+                                                 pack(array, iter, tag(head) + 1),
+                                                 memory_order_acquire,
+                                                 memory_order_acquire))
+                {
+                    if (count < n)
+                        count += try_bump_n(array, chunks + count, n - count);
+                    return count;
+                }
+            }
+            else
+            {
+                head = m_head.load(memory_order_acquire);
+            }
+        }
+    }
+
+    //! Frees the \p n chunks in the array \p chunks. The chunks are linked
+    //! to a chain first, which is then put onto the list with a single
+    //! compare-and-swap.
+    void free_n(const ChunkArray& array, void** chunks, std::size_t n) noexcept
+    {
+        if (n == 0)
+            return;
+
+        for (std::size_t idx = 1; idx < n; ++idx)
+            chunk_link(chunks[idx - 1]) = chunks[idx];
+
+        std::uint64_t head = m_head.load(memory_order_relaxed);
+        do
+        {
+            chunk_link(chunks[n - 1]) = pointer(array, head);
+        } while (!m_head.compare_exchange_weak(head,
+                                               pack(array, chunks[0],
+                                                    tag(head) + 1),
+                                               memory_order_release,
+                                               memory_order_relaxed));
+    }
+
+    //! Sorts the free chunks by address and calls \p f for every
+    //! allocated chunk. Must not be called concurrently with other
+    //! operations.
+    template <typename TFunction>
+    void for_each_allocated(const ChunkArray& array, TFunction&& f)
+    {
+        std::uint64_t head = m_head.load(memory_order_acquire);
+        void* sorted = sort_chunk_list(pointer(array, head));
+        m_head.store(pack(array, sorted, tag(head) + 1), memory_order_release);
+        for_each_chunk_not_in(sorted, array.memory, array.chunkSize,
+                              m_bump.load(memory_order_relaxed),
+                              std::forward<TFunction>(f));
+    }
+
+    //! Returns all chunks to the list. Must not be called concurrently with
+    //! other operations.
+    void clear() noexcept
+    {
+        std::uint64_t head = m_head.load(memory_order_relaxed);
+        m_head.store(std::uint64_t(tag(head) + 1) << 32, memory_order_release);
+        m_bump.store(0, memory_order_release);
+    }
+
+private:
+    //! The tagged offset of the first free chunk. The lower 32 bits hold the
+    //! offset relative to the start of the memory plus one or zero, if the
+    //! list is empty. The upper 32 bits hold the tag.
+    atomic<std::uint64_t> m_head;
+    //! The number of chunks, which have been handed out by the bump index.
+    atomic<std::uint32_t> m_bump;
+
+    static std::uint32_t offset(std::uint64_t head) noexcept
+    {
+        return std::uint32_t(head);
+    }
+
+    static std::uint32_t tag(std::uint64_t head) noexcept
+    {
+        return std::uint32_t(head >> 32);
+    }
+
+    //! Returns \p true, if a link can be read from \p p.
+    static bool contains(const ChunkArray& array, void* p) noexcept
+    {
+        return static_cast<char*>(p) >= array.memory
+               && static_cast<char*>(p) + sizeof(void*)
+                  <= array.memory + array.chunkSize * array.numChunks;
+    }
+
+    //! Converts the tagged \p head to a pointer to the first chunk.
+    static void* pointer(const ChunkArray& array, std::uint64_t head) noexcept
+    {
+        return offset(head) != 0 ? array.memory + (offset(head) - 1) : 0;
+    }
+
+    //! Combines the \p chunk and the \p tag to a tagged head.
+    static std::uint64_t pack(const ChunkArray& array, void* chunk,
+                              std::uint32_t tag) noexcept
+    {
+        std::uint32_t offset = chunk != 0
+                               ? std::uint32_t(array.offset(chunk) + 1)
+                               : 0;
+        return (std::uint64_t(tag) << 32) | offset;
+    }
+
+    //! Takes up to \p n chunks, which have never been allocated, by
+    //! advancing the bump index. Returns the number of chunks.
+    std::size_t try_bump_n(const ChunkArray& array, void** chunks,
+                           std::size_t n) noexcept
+    {
+        std::uint32_t index = m_bump.load(memory_order_relaxed);
+        std::size_t count;
+        do
+        {
+            count = array.numChunks - index;
+            if (count == 0)
+                return 0;
+            if (count > n)
+                count = n;
+        } while (!m_bump.compare_exchange_weak(index, index + count,
+                                               memory_order_relaxed));
+
+        for (std::size_t idx = 0; idx < count; ++idx)
+            chunks[idx] = array.chunk(index + idx);
+        return count;
+    }
+};
+
+//! Returns an index, which is unique among all running threads. The index
+//! is recycled when its thread exits. If all indices are in use, the
+//! maximum value of std::size_t is returned.
+std::size_t thread_cache_index() noexcept;
+
+} // namespace weos_detail
+
+//! A shared memory pool.
+//! A shared_memory_pool is a thread-safe alternative to the memory_pool.
+//! Like its non-threaded counterpart, it holds the memory for up to
+//! (\p TNumElem) elements of type \p TElement internally and does not
+//! allocate them on the heap.
+//!
+//! The pool is lock-free, i.e. neither allocating nor freeing a chunk
+//! acquires a mutex.
+//!
+//! The optional \p TLayout determines the placement of the chunks. By
+//! default, the chunks are packed densely (compact_chunk_layout). With
+//! cacheline_aligned, every chunk starts on a new cache line.
+template <typename TElement, std::size_t TNumElem,
+          typename TLayout = compact_chunk_layout>
+class shared_memory_pool : public weos_detail::PoolStatistics
+{
+public:
+    //! The type of the elements in this pool.
+    typedef TElement element_type;
+
+private:
+    static_assert(TNumElem > 0, "The number of elements must be non-zero.");
+
+    typedef typename weos_detail::PoolChunk<element_type, TLayout>::type chunk_type;
+
+    // The SharedFreeList stores 32-bit offsets.
+    static_assert(sizeof(chunk_type) * TNumElem < 0xFFFFFFFF,
+                  "The pool is too large.");
+
+public:
+    //! Constructs a shared memory pool.
+    //! The constructor runs in constant time and is a constant expression.
+    constexpr shared_memory_pool() noexcept
+        : m_uninitialized()
+    {
+    }
+
+    shared_memory_pool(const shared_memory_pool&) = delete;
+    shared_memory_pool& operator=(const shared_memory_pool&) = delete;
+
+    //! Returns the number of pool elements.
+    //! Returns the number of elements for which the pool provides memory.
+    std::size_t capacity() const noexcept
+    {
+        return TNumElem;
+    }
+
+    //! Checks if the memory pool is empty.
+    //!
+    //! Returns \p true, if the memory pool is empty.
+    bool empty() const noexcept
+    {
+        return m_list.empty(chunk_array());
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is already empty, a null-pointer is returned.
+    //!
+    //! \sa free()
+    void* try_allocate() noexcept
+    {
+        void* chunk = m_list.try_allocate(chunk_array());
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until a chunk
+    //! is freed.
+    //!
+    //! \sa free()
+    void* allocate()
+    {
+        void* chunk = weos_detail::wait_and_claim(m_tq, [this] {
+            return m_list.try_allocate(chunk_array());
+        });
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Allocates a chunk from the pool with a timeout.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until either a
+    //! chunk is freed or the timeout duration \p d expires. In the latter
+    //! case, a null-pointer is returned.
+    //!
+    //! \sa free()
+    template <typename TRep, typename TPeriod>
+    void* try_allocate_for(const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_allocate_until(chrono::steady_clock::now() + d);
+    }
+
+    //! Allocates a chunk from the pool with a timeout.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is empty, the calling thread is blocked until either a
+    //! chunk is freed or the point in time \p time has been reached. In the
+    //! latter case, a null-pointer is returned.
+    //!
+    //! \sa free()
+    template <typename TClock, typename TDuration>
+    void* try_allocate_until(const chrono::time_point<TClock, TDuration>& time)
+    {
+        void* chunk = weos_detail::wait_and_claim_until(m_tq, [this] {
+            return m_list.try_allocate(chunk_array());
+        }, time);
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Frees a chunk of memory.
+    //! Frees a \p chunk of memory which must have been allocated through
+    //! this pool.
+    //!
+    //! \sa try_allocate()
+    void free(void* chunk) noexcept
+    {
+        m_list.free(chunk_array(), chunk);
+        this->record_free();
+        m_tq.notify_one();
+    }
+
+    //! Allocates multiple chunks from the pool.
+    //! Allocates up to \p n chunks and stores pointers to them in the
+    //! array \p chunks. The whole batch is taken from the pool with a single
+    //! atomic operation. The method returns the number of allocated chunks,
+    //! which is less than \p n if the pool runs empty.
+    //!
+    //! \sa free_n()
+    std::size_t try_allocate_n(void** chunks, std::size_t n) noexcept
+    {
+        std::size_t count = m_list.try_allocate_n(chunk_array(), chunks, n);
+        this->record_allocations(n, count);
+        return count;
+    }
+
+    //! Frees multiple chunks.
+    //! Returns the \p n chunks in the array \p chunks back to the pool
+    //! with a single atomic operation. All of them must have been allocated
+    //! from this pool.
+    //!
+    //! \sa try_allocate_n()
+    void free_n(void** chunks, std::size_t n) noexcept
+    {
+        m_list.free_n(chunk_array(), chunks, n);
+        this->record_free(n);
+        if (n != 0)
+            m_tq.notify_all();
+    }
+
+    //! Iterates over the allocated chunks.
+    //! Calls \p f for every allocated chunk in the order of increasing
+    //! addresses. The function is passed a void pointer to the chunk. It may
+    //! free the chunk but it must not allocate from the pool.
+    //!
+    //! In order to find the allocated chunks, the free-list is sorted by
+    //! address first. Thus, the iteration takes O(F log F + N) steps for F
+    //! free chunks and N chunks which have been allocated at least once.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool during the iteration.
+    template <typename TFunction>
+    void for_each_allocated(TFunction&& f)
+    {
+        m_list.for_each_allocated(chunk_array(), std::forward<TFunction>(f));
+    }
+
+    //! Frees all chunks.
+    //! Returns all chunks to the pool in constant time.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool concurrently.
+    void clear() noexcept
+    {
+        m_list.clear();
+        this->record_clear();
+        m_tq.notify_all();
+    }
+
+private:
+    //! The memory chunks for the elements and the free-list pointers.
+    //! The constructor initializes the dummy instead of the chunks, so that
+    //! the chunks are not filled at run-time.
+    union
+    {
+        char m_uninitialized;
+        chunk_type m_chunks[TNumElem];
+    };
+    //! The lock-free list of free chunks.
+    weos_detail::SharedFreeList m_list;
+    //! The threads which wait for a chunk.
+    weos_detail::_tq m_tq;
+
+    //! Returns the chunks, which are managed by the free-list.
+    weos_detail::ChunkArray chunk_array() const noexcept
+    {
+        return weos_detail::ChunkArray{
+                   reinterpret_cast<char*>(const_cast<chunk_type*>(m_chunks)),
+                   sizeof(chunk_type), TNumElem};
+    }
+};
+
+//! A shared memory pool with per-thread caches.
+//! The magazine_memory_pool is a thread-safe memory pool, which holds the
+//! memory for up to (\p TNumElem) elements of type \p TElement internally.
+//! In front of the lock-free list of chunks, every thread has its own
+//! magazine, which is a small stack of up to (\p TMagazineSize) chunks.
+//! Allocations and deallocations are served from the calling thread's
+//! magazine without any synchronization. Only if the magazine runs empty,
+//! it is refilled with a batch of chunks from the shared list. Similarly,
+//! half of the magazine is returned to the shared list if it overflows.
+//!
+//! The pool provides (\p TNumMagazines) magazines. Threads whose cache
+//! index exceeds this number access the shared list directly.
+//!
+//! \note Chunks which are cached in a thread's magazine cannot be allocated
+//! by another thread. Therefore, try_allocate() can fail although not all
+//! chunks are in use. A thread can return its cached chunks by calling
+//! flush().
+template <typename TElement, std::size_t TNumElem,
+          std::size_t TMagazineSize = 16, std::size_t TNumMagazines = 8>
+class magazine_memory_pool : public weos_detail::PoolStatistics
+{
+public:
+    //! The type of the elements in this pool.
+    typedef TElement element_type;
+
+private:
+    static_assert(TNumElem > 0, "The number of elements must be non-zero.");
+    static_assert(TMagazineSize >= 2, "The magazine size must be at least 2.");
+
+    typedef typename weos_detail::PoolChunk<
+                         element_type, compact_chunk_layout>::type chunk_type;
+
+    // The SharedFreeList stores 32-bit offsets.
+    static_assert(sizeof(chunk_type) * TNumElem < 0xFFFFFFFF,
+                  "The pool is too large.");
+
+    // A per-thread stack of chunks. The magazines are aligned to a cache
+    // line such that threads do not write to the same line.
+    struct alignas(WEOS_CACHE_LINE_SIZE) Magazine
+    {
+        constexpr Magazine() noexcept
+            : count(0),
+              chunks{}
+        {
+        }
+
+        std::size_t count;
+        void* chunks[TMagazineSize];
+    };
+
+public:
+    //! Constructs a pool with empty magazines.
+    //! The constructor runs in constant time and is a constant expression.
+    constexpr magazine_memory_pool() noexcept
+        : m_uninitialized()
+    {
+    }
+
+    magazine_memory_pool(const magazine_memory_pool&) = delete;
+    magazine_memory_pool& operator=(const magazine_memory_pool&) = delete;
+
+    //! Returns the number of pool elements.
+    //! Returns the number of elements for which the pool provides memory.
+    std::size_t capacity() const noexcept
+    {
+        return TNumElem;
+    }
+
+    //! Checks if the memory pool is empty.
+    //! Returns \p true, if neither the shared list nor the calling thread's
+    //! magazine hold a chunk.
+    bool empty() const noexcept
+    {
+        std::size_t index = weos_detail::thread_cache_index();
+        return (index >= TNumMagazines || m_magazines[index].count == 0)
+               && m_list.empty(chunk_array());
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates one chunk from the calling thread's magazine or, if it is
+    //! empty, from the shared list. If no chunk is available, a null-pointer
+    //! is returned.
+    //!
+    //! \sa free()
+    void* try_allocate() noexcept
+    {
+        void* chunk = 0;
+        Magazine* magazine = local_magazine();
+        if (magazine == 0)
+        {
+            chunk = m_list.try_allocate(chunk_array());
+        }
+        else
+        {
+            if (magazine->count == 0)
+                magazine->count = m_list.try_allocate_n(chunk_array(),
+                                                        magazine->chunks,
+                                                        TMagazineSize / 2);
+            if (magazine->count != 0)
+                chunk = magazine->chunks[--magazine->count];
+        }
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Frees a previously allocated chunk.
+    //! Puts the \p chunk into the calling thread's magazine. If the magazine
+    //! is full, one half of it is returned to the shared list first.
+    //!
+    //! \sa try_allocate()
+    void free(void* chunk) noexcept
+    {
+        this->record_free();
+        Magazine* magazine = local_magazine();
+        if (magazine == 0)
+        {
+            m_list.free(chunk_array(), chunk);
+            return;
+        }
+
+        if (magazine->count == TMagazineSize)
+        {
+            magazine->count -= TMagazineSize / 2;
+            m_list.free_n(chunk_array(),
+                          &magazine->chunks[magazine->count],
+                          TMagazineSize / 2);
+        }
+        magazine->chunks[magazine->count++] = chunk;
+    }
+
+    //! Returns all chunks in the calling thread's magazine to the shared
+    //! list.
+    void flush() noexcept
+    {
+        Magazine* magazine = local_magazine();
+        if (magazine != 0)
+        {
+            m_list.free_n(chunk_array(), magazine->chunks, magazine->count);
+            magazine->count = 0;
+        }
+    }
+
+private:
+    //! The memory chunks for the elements and the free-list pointers.
+    //! The constructor initializes the dummy instead of the chunks, so that
+    //! the chunks are not filled at run-time.
+    union
+    {
+        char m_uninitialized;
+        chunk_type m_chunks[TNumElem];
+    };
+    //! The lock-free list of free chunks.
+    weos_detail::SharedFreeList m_list;
+    //! The per-thread magazines.
+    Magazine m_magazines[TNumMagazines];
+
+    //! Returns the chunks, which are managed by the free-list.
+    weos_detail::ChunkArray chunk_array() const noexcept
+    {
+        return weos_detail::ChunkArray{
+                   reinterpret_cast<char*>(const_cast<chunk_type*>(m_chunks)),
+                   sizeof(chunk_type), TNumElem};
+    }
+
+    //! Returns the calling thread's magazine or a null-pointer, if the
+    //! thread does not have one.
+    Magazine* local_magazine() noexcept
+    {
+        std::size_t index = weos_detail::thread_cache_index();
+        return index < TNumMagazines ? &m_magazines[index] : 0;
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_MEMORYPOOL_HPP
@@ -0,0 +1,85 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_MESSAGEQUEUE_HPP
+#define WEOS_CXX11_MESSAGEQUEUE_HPP
+
+#include "_core.hpp"
+
+#include "_tq.hpp"
+
+#include "../_common/_mpmcmessagequeue.hpp"
+#include "../_common/_prioritymessagequeue.hpp"
+#include "../_common/_spscmessagequeue.hpp"
+
+#include <cstddef>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A message queue.
+//! The message_queue is an object to pass elements from one thread to another
+//! in a thread-safe manner. The object statically holds the necessary memory.
+//!
+//! The elements are stored in a lock-free ring buffer. A thread is only
+//! blocked, if it has to wait for the queue to become non-empty (receive())
+//! or non-full (send()).
+//!
+//! If the macro WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS is defined in the user
+//! configuration, the queue records its occupancy and the latency of the
+//! elements, which can be queried with statistics().
+template <typename TType, std::size_t TQueueSize>
+class message_queue
+        : public weos_detail::MpmcMessageQueue<
+                     TType, TQueueSize,
+                     weos_detail::MessageQueueStatistics<TQueueSize>>
+{
+public:
+    //! The type of the elements transfered via this message queue.
+    typedef TType value_type;
+
+    //! \brief Creates a message queue.
+    //!
+    //! Creates an empty message queue.
+    message_queue() = default;
+
+    message_queue(const message_queue&) = delete;
+    message_queue& operator=(const message_queue&) = delete;
+
+    //! \brief Returns the capacity.
+    //!
+    //! Returns the maximum number of elements which the queue can hold.
+    std::size_t capacity() const noexcept
+    {
+        return TQueueSize;
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_MESSAGEQUEUE_HPP
@@ -37,11 +37,11 @@ semaphore::~semaphore()
 
 void semaphore::post()
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
     m_mutex.lock();
     ++m_value;
     m_mutex.unlock();
     m_conditionVariable.notify_one();
+    m_selectors.notify_all();
 }
 
 void semaphore::wait()
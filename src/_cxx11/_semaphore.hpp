@@ -31,6 +31,7 @@
 
 #include "_core.hpp"
 
+#include "_tq.hpp"
 #include "../chrono.hpp"
 #include "../condition_variable.hpp"
 #include "../mutex.hpp"
@@ -133,10 +134,28 @@ public:
         return this;
     }
 
+    //! Checks if a token is available. Used by wait_any().
+    friend
+    bool select_ready(const semaphore& sem)
+    {
+        return sem.value() != 0;
+    }
+
+    //! Returns the queue of the threads which wait for this semaphore in
+    //! wait_any(). Used by wait_any().
+    friend
+    weos_detail::_tq& select_queue(const semaphore& sem) noexcept
+    {
+        return sem.m_selectors;
+    }
+
 private:
     value_type m_value;
     mutable std::mutex m_mutex;
     std::condition_variable m_conditionVariable;
+    //! The threads which wait for this semaphore in wait_any(). It is
+    //! notified whenever the semaphore is posted.
+    mutable weos_detail::_tq m_selectors;
 };
 
 WEOS_END_NAMESPACE
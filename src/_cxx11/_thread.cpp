@@ -27,6 +27,7 @@
 *******************************************************************************/
 
 #include "_thread.hpp"
+#include "_tq.hpp"
 #include "../memory.hpp"
 
 #include <cstdint>
@@ -288,9 +289,12 @@ void thread::set_signals(signal_set flags)
         WEOS_THROW_SYSTEM_ERROR(std::errc::operation_not_permitted,
                                 "thread::set_signals: no thread");
 
-    std::lock_guard<std::mutex> lock(m_data->m_mutex);
-    m_data->m_signalFlags |= flags;
-    m_data->m_signal.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(m_data->m_mutex);
+        m_data->m_signalFlags |= flags;
+        m_data->m_signal.notify_one();
+    }
+    m_data->m_signalSelectors.notify_one();
 }
 
 void thread::threadedFunction(std::shared_ptr<weos_detail::SharedThreadStateBase> state) noexcept
@@ -334,6 +338,26 @@ void thread::threadedFunction(std::shared_ptr<weos_detail::SharedThreadStateBase
     manager.remove(std::this_thread::get_id());
 }
 
+namespace weos_detail
+{
+
+thread::signal_set current_signals()
+{
+    SharedThreadStateBase& data = SharedThreadStateManager::instance().find(
+                                      std::this_thread::get_id());
+
+    std::lock_guard<std::mutex> lock(data.m_mutex);
+    return data.m_signalFlags;
+}
+
+_tq& current_signal_selectors()
+{
+    return SharedThreadStateManager::instance().find(
+               std::this_thread::get_id()).m_signalSelectors;
+}
+
+} // namespace weos_detail
+
 // ----=====================================================================----
 //     Waiting for signals
 // ----=====================================================================----
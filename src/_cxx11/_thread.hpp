@@ -32,6 +32,7 @@
 #include "_core.hpp"
 
 #include "_thread_detail.hpp"
+#include "_tq.hpp"
 #include "../atomic.hpp"
 #include "../condition_variable.hpp"
 #include "../chrono.hpp"
@@ -187,6 +188,10 @@ struct SharedThreadStateBase
     // The signal flags.
     std::uint16_t m_signalFlags;
 
+    // The thread waits in this queue for its signals in wait_any(). It is
+    // notified whenever the signals of this thread are set.
+    _tq m_signalSelectors;
+
     // The native thread handle.
     std::thread m_thread;
 
@@ -382,6 +387,18 @@ private:
     void threadedFunction(std::shared_ptr<weos_detail::SharedThreadStateBase> state) noexcept;
 };
 
+namespace weos_detail
+{
+
+//! Returns the signal flags of the current thread without resetting them.
+thread::signal_set current_signals();
+
+//! Returns the queue, in which the current thread waits for its signals in
+//! wait_any().
+_tq& current_signal_selectors();
+
+} // namespace weos_detail
+
 // ----=====================================================================----
 //     Waiting for signals
 // ----=====================================================================----
@@ -0,0 +1,140 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include "_tq.hpp"
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+_tq::_t::_t(_tq& q)
+    : m_tq(q),
+      m_waiter(*this),
+      m_next(nullptr),
+      m_linked(true),
+      m_notified(false),
+      m_woken(false)
+{
+    link();
+}
+
+_tq::_t::_t(_tq& q, _t& waiter)
+    : m_tq(q),
+      m_waiter(waiter),
+      m_next(nullptr),
+      m_linked(true),
+      m_notified(false),
+      m_woken(false)
+{
+    link();
+}
+
+void _tq::_t::link()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_tq.m_mutex);
+        if (m_tq.m_tail)
+            m_tq.m_tail->m_next = this;
+        else
+            m_tq.m_h.store(this);
+        m_tq.m_tail = this;
+    }
+
+    // Pairs with the fence in notify_one() and notify_all(). Either the
+    // caller sees the state change when re-checking its condition or the
+    // notifier sees this waiter.
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+bool _tq::_t::unlink() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_tq.m_mutex);
+    if (m_linked)
+    {
+        _t* prev = nullptr;
+        _t* iter = m_tq.m_h.load(memory_order_relaxed);
+        while (iter != this)
+        {
+            prev = iter;
+            iter = iter->m_next;
+        }
+
+        if (prev)
+            prev->m_next = m_next;
+        else
+            m_tq.m_h.store(m_next);
+        if (m_tq.m_tail == this)
+            m_tq.m_tail = prev;
+        m_linked = false;
+    }
+    return m_notified;
+}
+
+void _tq::notify_one() noexcept
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (m_h.load(memory_order_relaxed) == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    _t* t = m_h.load(memory_order_relaxed);
+    if (!t)
+        return;
+
+    m_h.store(t->m_next);
+    if (m_tail == t)
+        m_tail = nullptr;
+    t->m_linked = false;
+    t->m_notified = true;
+    t->m_waiter.wake();
+}
+
+void _tq::notify_all() noexcept
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (m_h.load(memory_order_relaxed) == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    _t* t = m_h.exchange(nullptr);
+    m_tail = nullptr;
+    while (t)
+    {
+        _t* next = t->m_next;
+        t->m_linked = false;
+        t->m_notified = true;
+        t->m_waiter.wake();
+        t = next;
+    }
+}
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
@@ -0,0 +1,156 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_CXX11_TQ_HPP
+#define WEOS_CXX11_TQ_HPP
+
+#include "_core.hpp"
+
+#include "../atomic.hpp"
+#include "../chrono.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+//! A queue of waiting threads.
+//! This is the C++11 counterpart of the wait queue in the CMSIS-RTOS
+//! backend. A thread which wants to wait for a condition links a _t object
+//! into the queue, re-checks the condition and only then blocks. Thus, a
+//! notification which is sent after the _t has been linked cannot be lost.
+//! Notifying an empty queue only costs a fence and an atomic load.
+//!
+//! A thread can wait in several queues at once. It links one _t into every
+//! queue and passes the first one as the waiter to the others. A
+//! notification of any of them wakes the waiter.
+struct _tq
+{
+    struct _t
+    {
+        _t(_tq& q);
+
+        //! Links into the queue \p q. A notification wakes the \p waiter,
+        //! which must outlive this object.
+        _t(_tq& q, _t& waiter);
+
+        ~_t()
+        {
+            unlink();
+        }
+
+        _t(const _t&) = delete;
+        _t& operator=(const _t&) = delete;
+
+        //! Removes this waiter from the queue. Returns \p true, if it has
+        //! been notified before.
+        bool unlink() noexcept;
+
+        explicit
+        operator bool() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(m_tq.m_mutex);
+            return m_notified;
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_woken; });
+        }
+
+        template <typename TRep, typename TPeriod>
+        inline
+        bool wait_for(const chrono::duration<TRep, TPeriod>& timeout)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            return m_cv.wait_for(lock, timeout, [this] { return m_woken; });
+        }
+
+        template <typename TClock, typename TDuration>
+        inline
+        bool wait_until(const chrono::time_point<TClock, TDuration>& time)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            return m_cv.wait_until(lock, time, [this] { return m_woken; });
+        }
+
+        //! Wakes the thread which waits in this object.
+        void wake() noexcept
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_woken = true;
+            m_cv.notify_one();
+        }
+
+        _tq& m_tq;
+        _t& m_waiter;
+        //! The next waiter in the queue. Protected by the queue's mutex.
+        _t* m_next;
+        bool m_linked;
+        bool m_notified;
+        //! Protects m_woken. It is always locked last, such that a
+        //! notifier can wake a waiter in another queue.
+        std::mutex m_mutex;
+        bool m_woken;
+        std::condition_variable m_cv;
+
+    private:
+        void link();
+    };
+
+
+
+    _tq() = default;
+
+    _tq(const _tq&) = delete;
+    _tq& operator=(const _tq&) = delete;
+
+    void notify_one() noexcept;
+    void notify_all() noexcept;
+
+
+
+    //! Protects the list of waiters.
+    mutable std::mutex m_mutex;
+    //! The first waiter. It is written with the mutex held but read without
+    //! it, such that a notification is cheap when nobody waits.
+    atomic<_t*> m_h{nullptr};
+    //! The last waiter.
+    _t* m_tail{nullptr};
+};
+
+} // namespace weos_detail
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_CXX11_TQ_HPP
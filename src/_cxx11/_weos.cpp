@@ -28,5 +28,7 @@
 
 #include "_core.hpp"
 
+#include "_memorypool.cpp"
 #include "_semaphore.cpp"
 #include "_thread.cpp"
+#include "_tq.cpp"
@@ -0,0 +1,318 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_MAILQUEUE_HPP
+#define WEOS_MAILQUEUE_HPP
+
+#include "_config.hpp"
+
+#include "chrono.hpp"
+#include "memory.hpp"
+#include "memorypool.hpp"
+#include "messagequeue.hpp"
+#include "type_traits.hpp"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A mail queue.
+//! A mail queue combines a pool of (\p TNumElem) mails of type \p TElement
+//! with a queue, through which pointers to these mails are passed. A
+//! producer allocates a mail, fills it and sends it. A consumer receives the
+//! mail and frees it after use. The mail itself is never copied.
+//!
+//! The free mails are kept in a shared_memory_pool. Freeing a mail never
+//! waits and may be done in an interrupt context. The sent mails are passed
+//! through a lock-free ring of pointers, which can hold every mail of the
+//! pool. A producer waits in allocate() while no mail is free and a
+//! consumer waits in receive() while no mail has been sent. A sender only
+//! waits in the rare case that the ring slot for its mail is still held by
+//! a receiver, which has been preempted while taking out another mail.
+//!
+//! Ownership of a mail is best managed by the unique pointers which are
+//! returned from allocate() and receive(). Their deleter returns the mail
+//! to this queue. Alternatively, the pointer can be released from the
+//! unique pointer and the mail can be sent and freed manually.
+template <typename TElement, std::size_t TNumElem>
+class mail_queue
+{
+    static_assert(TNumElem > 0, "The number of elements must be non-zero.");
+
+public:
+    //! The type of the mails.
+    typedef TElement element_type;
+
+    //! The deleter of the unique pointers, which are returned by
+    //! allocate() and receive(). It destroys the mail and returns it to
+    //! the mail queue.
+    class element_deleter
+    {
+    public:
+        element_deleter() noexcept
+            : m_queue(0)
+        {
+        }
+
+        explicit
+        element_deleter(mail_queue& queue) noexcept
+            : m_queue(&queue)
+        {
+        }
+
+        void operator()(element_type* mail) const noexcept
+        {
+            m_queue->free(mail);
+        }
+
+    private:
+        mail_queue* m_queue;
+    };
+
+    //! A unique pointer to a mail of this queue.
+    typedef unique_ptr<element_type, element_deleter> unique_pointer;
+
+    //! Creates a mail queue.
+    mail_queue() = default;
+
+    mail_queue(const mail_queue&) = delete;
+    mail_queue& operator=(const mail_queue&) = delete;
+
+    //! Destroys the mail queue.
+    //! Destroys the mails which have been sent but not received. All other
+    //! mails must have been freed before.
+    ~mail_queue()
+    {
+        m_mails.drain([](element_type* mail) {
+            mail->~element_type();
+        });
+    }
+
+    //! Returns the number of mails.
+    //! Returns the number of mails for which the queue provides memory.
+    std::size_t capacity() const noexcept
+    {
+        return TNumElem;
+    }
+
+    //! Allocates a mail.
+    //! Allocates a mail and constructs it from the given \p args. If no mail
+    //! is free, the calling thread is blocked until a mail has been freed.
+    template <typename... TArgs>
+    unique_pointer allocate(TArgs&&... args)
+    {
+        return construct(m_pool.allocate(), std::forward<TArgs>(args)...);
+    }
+
+    //! Tries to allocate a mail.
+    //! Allocates a mail and constructs it from the given \p args. If no mail
+    //! is free, an empty pointer is returned immediately.
+    //!
+    //! \note This method may be called in an interrupt context, if the
+    //! constructor of \p element_type may be called there.
+    template <typename... TArgs>
+    unique_pointer try_allocate(TArgs&&... args)
+    {
+        void* mail = m_pool.try_allocate();
+        if (!mail)
+            return unique_pointer(0, element_deleter(*this));
+        return construct(mail, std::forward<TArgs>(args)...);
+    }
+
+    //! Tries to allocate a mail with a timeout.
+    //! Allocates a mail and constructs it from the given \p args. If no mail
+    //! is free, the calling thread is blocked until either a mail is freed
+    //! or the timeout duration \p d expires. In the latter case, an empty
+    //! pointer is returned.
+    template <typename TRep, typename TPeriod, typename... TArgs>
+    unique_pointer try_allocate_for(const chrono::duration<TRep, TPeriod>& d,
+                                    TArgs&&... args)
+    {
+        return try_allocate_until(chrono::steady_clock::now() + d,
+                                  std::forward<TArgs>(args)...);
+    }
+
+    //! Tries to allocate a mail with a timeout.
+    //! Allocates a mail and constructs it from the given \p args. If no mail
+    //! is free, the calling thread is blocked until either a mail is freed
+    //! or the point in time \p time has been reached. In the latter case,
+    //! an empty pointer is returned.
+    template <typename TClock, typename TDuration, typename... TArgs>
+    unique_pointer try_allocate_until(
+            const chrono::time_point<TClock, TDuration>& time,
+            TArgs&&... args)
+    {
+        void* mail = m_pool.try_allocate_until(time);
+        if (!mail)
+            return unique_pointer(0, element_deleter(*this));
+        return construct(mail, std::forward<TArgs>(args)...);
+    }
+
+    //! Sends a mail.
+    //! Appends the \p mail, which must have been allocated from this queue,
+    //! to the queue. The ownership of the mail is passed to the receiver.
+    void send(unique_pointer&& mail)
+    {
+        WEOS_ASSERT(mail);
+        send(mail.release());
+    }
+
+    //! Sends a mail.
+    //! Appends the \p mail, which must have been allocated from this queue,
+    //! to the queue. The ownership of the mail is passed to the receiver.
+    void send(element_type* mail)
+    {
+        WEOS_ASSERT(owns(mail));
+        // There are never more than TNumElem mails, so the ring has room for
+        // all of them. However, the ring's slots are released in the order
+        // in which the receivers finish. The slot for the mail might still
+        // be held by a receiver, which has already taken out its pointer. In
+        // this rare case, send() blocks until that receiver is done.
+        m_mails.send(mail);
+    }
+
+    //! Receives a mail.
+    //! Returns the first mail from the queue. If the queue is empty, the
+    //! calling thread is blocked until a mail is sent. The returned pointer
+    //! frees the mail when it goes out of scope.
+    unique_pointer receive()
+    {
+        return unique_pointer(m_mails.receive(), element_deleter(*this));
+    }
+
+    //! Tries to receive a mail.
+    //! Returns the first mail from the queue. If the queue is empty, an
+    //! empty pointer is returned immediately.
+    //!
+    //! \note This method may be called in an interrupt context.
+    unique_pointer try_receive() noexcept
+    {
+        element_type* mail = 0;
+        m_mails.try_receive(mail);
+        return unique_pointer(mail, element_deleter(*this));
+    }
+
+    //! Tries to receive a mail with a timeout.
+    //! Returns the first mail from the queue. If the queue is empty, the
+    //! calling thread is blocked until either a mail is sent or the timeout
+    //! duration \p d expires. In the latter case, an empty pointer is
+    //! returned.
+    template <typename TRep, typename TPeriod>
+    unique_pointer try_receive_for(const chrono::duration<TRep, TPeriod>& d)
+    {
+        return try_receive_until(chrono::steady_clock::now() + d);
+    }
+
+    //! Tries to receive a mail with a timeout.
+    //! Returns the first mail from the queue. If the queue is empty, the
+    //! calling thread is blocked until either a mail is sent or the point in
+    //! time \p time has been reached. In the latter case, an empty pointer
+    //! is returned.
+    template <typename TClock, typename TDuration>
+    unique_pointer try_receive_until(
+            const chrono::time_point<TClock, TDuration>& time)
+    {
+        element_type* mail = 0;
+        m_mails.try_receive_until(mail, time);
+        return unique_pointer(mail, element_deleter(*this));
+    }
+
+    //! Frees a mail.
+    //! Destroys the \p mail, which must have been allocated from this queue,
+    //! and makes it available for allocation again. Freeing never blocks.
+    //!
+    //! \note This method may be called in an interrupt context, if the
+    //! destructor of \p element_type may be called there.
+    void free(element_type* mail) noexcept
+    {
+        WEOS_ASSERT(owns(mail));
+        mail->~element_type();
+        m_pool.free(mail);
+    }
+
+    //! Checks if a mail can be received. Used by wait_any().
+    friend
+    bool select_ready(const mail_queue& queue) noexcept
+    {
+        return select_ready(queue.m_mails);
+    }
+
+    //! Returns the queue of the waiting receivers. Used by wait_any().
+    friend
+    weos_detail::_tq& select_queue(mail_queue& queue) noexcept
+    {
+        return select_queue(queue.m_mails);
+    }
+
+private:
+    typedef shared_memory_pool<element_type, TNumElem> pool_type;
+
+    //! The memory for the mails.
+    pool_type m_pool;
+    //! The mails which have been sent but not yet received.
+    weos_detail::MpmcMessageQueue<element_type*, TNumElem> m_mails;
+
+    //! Checks if the \p mail belongs to this queue. The pool stores its
+    //! chunks inline, so they lie within the pool object.
+    bool owns(const element_type* mail) const noexcept
+    {
+        const void* chunk = mail;
+        return chunk >= static_cast<const void*>(&m_pool)
+               && chunk < static_cast<const void*>(&m_pool + 1);
+    }
+
+    //! Constructs an element in the chunk \p mail. If the constructor
+    //! throws, the chunk is returned to the pool.
+    template <typename... TArgs>
+    unique_pointer construct(void* mail, TArgs&&... args)
+    {
+        struct Guard
+        {
+            ~Guard()
+            {
+                if (m_mail)
+                    m_pool.free(m_mail);
+            }
+
+            pool_type& m_pool;
+            void* m_mail;
+        } guard{m_pool, mail};
+
+        element_type* element
+                = new (mail) element_type(std::forward<TArgs>(args)...);
+        guard.m_mail = 0;
+        return unique_pointer(element, element_deleter(*this));
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_MAILQUEUE_HPP
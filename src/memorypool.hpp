@@ -31,72 +31,565 @@
 
 #include "_config.hpp"
 
+#include "atomic.hpp"
 #include "mutex.hpp"
 #include "semaphore.hpp"
 #include "type_traits.hpp"
+#include "_common/_bitops.hpp"
 
 #include <cstddef>
+#include <cstdint>
+#include <utility>
 
 
 WEOS_BEGIN_NAMESPACE
 
+//! Allocation statistics of a memory pool.
+//! The statistics are only recorded if the macro
+//! WEOS_ENABLE_POOL_STATISTICS is defined in the user configuration.
+struct pool_statistics
+{
+    //! The number of chunks which are currently allocated.
+    std::size_t current_use;
+    //! The maximum number of chunks which have been allocated at the same
+    //! time.
+    std::size_t high_water_mark;
+    //! The number of allocation requests which could not be served.
+    std::size_t allocation_failures;
+    //! The total number of chunks which have been allocated.
+    std::size_t total_allocations;
+};
+
+//! A chunk layout, which packs the chunks of a pool as densely as possible.
+//! Every chunk is just large enough for an element or a pointer and
+//! is aligned to the stricter alignment of both.
+struct compact_chunk_layout
+{
+    static const std::size_t alignment = 1;
+};
+
+//! A chunk layout, which aligns every chunk of a pool to (\p TAlignment)
+//! bytes and pads its size to a multiple of this value. \p TAlignment must
+//! be a power of two.
+template <std::size_t TAlignment>
+struct aligned_chunk_layout
+{
+    static_assert(TAlignment > 0 && (TAlignment & (TAlignment - 1)) == 0,
+                  "The alignment must be a power of two.");
+
+    static const std::size_t alignment = TAlignment;
+};
+
+//! A chunk layout, which places every chunk in its own cache lines. Elements
+//! which are allocated from the pool by different threads do not share a
+//! cache line and thus, false sharing is avoided. The cache line size is
+//! set with the macro WEOS_CACHE_LINE_SIZE.
+typedef aligned_chunk_layout<WEOS_CACHE_LINE_SIZE> cacheline_aligned;
+
+//! A chunk layout, which enables pool handles. The chunks are placed
+//! according to the layout \p TLayout. In addition, a memory_pool keeps a
+//! generation tag for every chunk, such that the chunks can be referred to
+//! by a pool_handle. The tags cost one byte per chunk and have to be updated
+//! whenever a chunk is freed. Therefore, they are only stored if a pool
+//! uses this layout.
+template <typename TLayout = compact_chunk_layout>
+struct handle_chunk_layout
+{
+    static const std::size_t alignment = TLayout::alignment;
+};
+
+//! A compact handle to an element in a pool.
+//! A pool_handle refers to a chunk of a memory_pool or an object_pool
+//! with a handle_chunk_layout using only 32 bits. The lower 24 bits store the index of the chunk and
+//! the upper 8 bits hold a generation tag. The tag is advanced whenever the
+//! chunk is returned to the pool. Thus, a stale handle is (with high
+//! probability) detected when it is converted back to a pointer.
+//!
+//! As the handle is a trivially copyable 32-bit value, it can be passed
+//! through a message_queue without the overhead of storing large messages
+//! in the queue itself.
+//!
+//! A default-constructed handle is null and does not refer to any chunk.
+template <typename TElement>
+class pool_handle
+{
+public:
+    //! The type of the element to which the handle refers.
+    typedef TElement element_type;
+
+    //! The number of bits for the chunk index.
+    static const unsigned index_bits = 24;
+    //! The maximum number of chunks, which can be addressed by a handle.
+    static const std::uint32_t max_chunks = std::uint32_t(1) << index_bits;
+
+    //! Creates a null handle.
+    constexpr pool_handle() noexcept
+        : m_value(0)
+    {
+    }
+
+    //! Creates a handle from its raw \p value.
+    explicit constexpr
+    pool_handle(std::uint32_t value) noexcept
+        : m_value(value)
+    {
+    }
+
+    //! Creates a handle from a chunk \p index and a generation \p tag.
+    constexpr pool_handle(std::uint32_t index, std::uint8_t tag) noexcept
+        : m_value(index | (std::uint32_t(tag) << index_bits))
+    {
+    }
+
+    //! Returns the raw value of the handle.
+    constexpr std::uint32_t value() const noexcept
+    {
+        return m_value;
+    }
+
+    //! Returns the index of the chunk to which this handle refers.
+    constexpr std::uint32_t index() const noexcept
+    {
+        return m_value & (max_chunks - 1);
+    }
+
+    //! Returns the generation tag of this handle. The tag of a handle to an
+    //! allocated chunk is never zero.
+    constexpr std::uint8_t tag() const noexcept
+    {
+        return std::uint8_t(m_value >> index_bits);
+    }
+
+    //! Returns \p true, if the handle is not null.
+    explicit constexpr
+    operator bool() const noexcept
+    {
+        return m_value != 0;
+    }
+
+    constexpr bool operator==(pool_handle other) const noexcept
+    {
+        return m_value == other.m_value;
+    }
+
+    constexpr bool operator!=(pool_handle other) const noexcept
+    {
+        return m_value != other.m_value;
+    }
+
+private:
+    std::uint32_t m_value;
+};
+
+template <typename TElement>
+const unsigned pool_handle<TElement>::index_bits;
+
+template <typename TElement>
+const std::uint32_t pool_handle<TElement>::max_chunks;
+
 namespace weos_detail
 {
 
-class FreeList
+// Checks if the chunk layout TLayout enables pool handles.
+template <typename TLayout>
+struct has_pool_handles : false_type
+{
+};
+
+template <typename TLayout>
+struct has_pool_handles<handle_chunk_layout<TLayout> > : true_type
+{
+};
+
+// A mix-in, which stores the generation tags of a pool's chunks. The tag of
+// a chunk is advanced whenever the chunk is freed. The stored value cycles
+// through [0, 254] such that the tag of a handle (the stored value plus one)
+// is never zero.
+template <std::size_t TNumElem, bool TEnabled>
+class PoolHandleTags
+{
+protected:
+    constexpr PoolHandleTags() noexcept
+        : m_tags{}
+    {
+    }
+
+    std::uint8_t tag(std::size_t index) const noexcept
+    {
+        return m_tags[index] + 1;
+    }
+
+    void advance_tag(std::size_t index) noexcept
+    {
+        m_tags[index] = m_tags[index] == 254 ? 0 : m_tags[index] + 1;
+    }
+
+    void advance_all_tags() noexcept
+    {
+        for (std::size_t index = 0; index < TNumElem; ++index)
+            advance_tag(index);
+    }
+
+private:
+    std::uint8_t m_tags[TNumElem];
+};
+
+// Without handles, the mix-in is empty and the empty base optimization
+// ensures that it does not increase the size of a pool.
+template <std::size_t TNumElem>
+class PoolHandleTags<TNumElem, false>
+{
+protected:
+    void advance_tag(std::size_t) noexcept
+    {
+    }
+
+    void advance_all_tags() noexcept
+    {
+    }
+};
+
+// Computes the type of a pool chunk for elements of type TElement.
+template <typename TElement, typename TLayout>
+struct PoolChunk
+{
+    // Every chunk has to be aligned such that it can contain either a
+    // void* or an element. The layout can impose a stricter alignment.
+    static const std::size_t natural_align =
+            alignment_of<void*>::value > alignment_of<TElement>::value
+            ? alignment_of<void*>::value
+            : alignment_of<TElement>::value;
+    static const std::size_t align =
+            TLayout::alignment > natural_align
+            ? TLayout::alignment
+            : natural_align;
+    // The chunk size has to be large enough to store a void* or an element.
+    static const std::size_t size =
+            sizeof(void*) > sizeof(TElement)
+            ? sizeof(void*)
+            : sizeof(TElement);
+
+    // The aligned_storage<> rounds the size up to a multiple of the
+    // alignment.
+    typedef typename aligned_storage<size, align>::type type;
+};
+
+#if defined(WEOS_ENABLE_POOL_STATISTICS)
+
+// A mix-in, which records the allocation statistics of a pool. The counters
+// are updated with relaxed atomics because they are only informational.
+class PoolStatistics
 {
 public:
-    FreeList(void* memory, std::size_t chunkSize,
-             std::size_t numElements) noexcept
-        : m_first(memory)
+    //! Returns the allocation statistics of this pool.
+    pool_statistics statistics() const noexcept
+    {
+        pool_statistics result;
+        result.current_use = m_currentUse.load(memory_order_relaxed);
+        result.high_water_mark = m_highWaterMark.load(memory_order_relaxed);
+        result.allocation_failures = m_allocationFailures.load(memory_order_relaxed);
+        result.total_allocations = m_totalAllocations.load(memory_order_relaxed);
+        return result;
+    }
+
+protected:
+    constexpr PoolStatistics() noexcept
+        : m_currentUse(0),
+          m_highWaterMark(0),
+          m_allocationFailures(0),
+          m_totalAllocations(0)
+    {
+    }
+
+    void record_allocation(const void* chunk) noexcept
+    {
+        record_allocations(1, chunk != 0 ? 1 : 0);
+    }
+
+    void record_allocations(std::size_t requested,
+                            std::size_t allocated) noexcept
+    {
+        if (allocated < requested)
+            m_allocationFailures.fetch_add(1, memory_order_relaxed);
+        if (allocated == 0)
+            return;
+
+        m_totalAllocations.fetch_add(allocated, memory_order_relaxed);
+        std::size_t use = m_currentUse.fetch_add(allocated, memory_order_relaxed)
+                          + allocated;
+        std::size_t mark = m_highWaterMark.load(memory_order_relaxed);
+        while (use > mark
+               && !m_highWaterMark.compare_exchange_weak(
+                       mark, use, memory_order_relaxed))
+        {
+        }
+    }
+
+    void record_free(std::size_t n = 1) noexcept
+    {
+        m_currentUse.fetch_sub(n, memory_order_relaxed);
+    }
+
+    void record_clear() noexcept
+    {
+        m_currentUse.store(0, memory_order_relaxed);
+    }
+
+private:
+    atomic<std::size_t> m_currentUse;
+    atomic<std::size_t> m_highWaterMark;
+    atomic<std::size_t> m_allocationFailures;
+    atomic<std::size_t> m_totalAllocations;
+};
+
+#else
+
+// Without statistics, the mix-in is empty and the empty base optimization
+// ensures that it does not increase the size of a pool.
+class PoolStatistics
+{
+protected:
+    void record_allocation(const void*) noexcept
+    {
+    }
+
+    void record_allocations(std::size_t, std::size_t) noexcept
+    {
+    }
+
+    void record_free(std::size_t = 1) noexcept
+    {
+    }
+
+    void record_clear() noexcept
+    {
+    }
+};
+
+#endif // WEOS_ENABLE_POOL_STATISTICS
+
+//! Returns a reference to the link, which is stored in the first bytes of
+//! a free \p chunk.
+inline
+void*& chunk_link(void* chunk) noexcept
+{
+    return *static_cast<void**>(chunk);
+}
+
+//! Sorts a list of free chunks by increasing address and returns the new
+//! head of the list. The chunks are linked via chunk_link(). The list is
+//! sorted with a bottom-up merge sort, which needs O(n log n) steps and no
+//! additional memory.
+inline
+void* sort_chunk_list(void* list) noexcept
+{
+    if (list == 0)
+        return 0;
+
+    for (std::size_t width = 1; ; width *= 2)
     {
-        char* iter = static_cast<char*>(memory) + chunkSize * numElements;
-        char* prev = 0;
-        while (iter > static_cast<char*>(m_first))
+        void* p = list;
+        void** tail = &list;
+        std::size_t numMerges = 0;
+
+        while (p)
         {
-            iter -= chunkSize;
-            next(iter) = prev;
-            prev = iter;
+            ++numMerges;
+
+            // Split off two runs of (at most) width chunks.
+            void* q = p;
+            std::size_t pSize = 0;
+            while (pSize < width && q)
+            {
+                q = chunk_link(q);
+                ++pSize;
+            }
+            std::size_t qSize = width;
+
+            // Merge the runs.
+            while (pSize > 0 || (qSize > 0 && q))
+            {
+                void* chunk;
+                if (pSize == 0
+                    || (qSize > 0 && q
+                        && reinterpret_cast<std::uintptr_t>(q)
+                           < reinterpret_cast<std::uintptr_t>(p)))
+                {
+                    chunk = q;
+                    q = chunk_link(q);
+                    --qSize;
+                }
+                else
+                {
+                    chunk = p;
+                    p = chunk_link(p);
+                    --pSize;
+                }
+                *tail = chunk;
+                tail = &chunk_link(chunk);
+            }
+            p = q;
         }
+        *tail = 0;
+
+        if (numMerges <= 1)
+            return list;
+    }
+}
+
+//! Calls \p f for every chunk in the array of \p numChunks chunks of size
+//! \p chunkSize starting at \p memory, which is not contained in the list
+//! of free chunks \p sortedFree. The list has to be sorted by address.
+//! \p f may free the chunk, which is passed to it.
+template <typename TFunction>
+void for_each_chunk_not_in(void* sortedFree, void* memory,
+                           std::size_t chunkSize, std::size_t numChunks,
+                           TFunction&& f)
+{
+    char* iter = static_cast<char*>(memory);
+    for (std::size_t idx = 0; idx < numChunks; ++idx, iter += chunkSize)
+    {
+        if (iter == sortedFree)
+            sortedFree = chunk_link(sortedFree);
+        else
+            f(static_cast<void*>(iter));
+    }
+}
+
+// The chunks of a pool. A pool passes its chunks to the free-list with every
+// call instead of storing a pointer to them in the list. Thus, a pool does
+// not point to itself and its initial value is all zero bits, which places
+// a pool with static storage duration in the .bss section.
+struct ChunkArray
+{
+    //! The start of the memory.
+    char* memory;
+    //! The size of a chunk in bytes.
+    std::size_t chunkSize;
+    //! The number of chunks.
+    std::size_t numChunks;
+
+    //! Returns the chunk with the given \p index.
+    void* chunk(std::size_t index) const noexcept
+    {
+        return memory + chunkSize * index;
+    }
+
+    //! Returns the offset of the \p chunk relative to the start of the
+    //! memory.
+    std::size_t offset(const void* chunk) const noexcept
+    {
+        return static_cast<const char*>(chunk) - memory;
+    }
+};
+
+// A free-list, which is combined with a bump index. Initially, the list
+// is empty and all chunks are handed out by advancing the bump index.
+// Freed chunks are put onto the list and are preferred for subsequent
+// allocations. As the chunks are never linked in advance, the list can be
+// constructed in constant time and even as a constant expression.
+//
+// The head of the list is stored as the offset of the first free chunk plus
+// one. An empty list has a zero head.
+class FreeList
+{
+public:
+    constexpr FreeList() noexcept
+        : m_first(0),
+          m_numTouched(0)
+    {
     }
 
     FreeList(const FreeList&) = delete;
     FreeList& operator=(const FreeList&) = delete;
 
-    bool empty() const noexcept
+    bool empty(const ChunkArray& array) const noexcept
     {
-        return m_first == 0;
+        return m_first == 0 && m_numTouched == array.numChunks;
     }
 
-    void* first() const noexcept
+    void* try_allocate(const ChunkArray& array) noexcept
     {
-        return m_first;
+        if (m_first != 0)
+        {
+            void* chunk = first(array);
+            set_first(array, chunk_link(chunk));
+            return chunk;
+        }
+        if (m_numTouched != array.numChunks)
+            return array.chunk(m_numTouched++);
+        return 0;
     }
 
-    void* try_allocate() noexcept
+    void free(const ChunkArray& array, void* chunk) noexcept
     {
-        if (m_first == 0)
-            return 0;
+        chunk_link(chunk) = first(array);
+        set_first(array, chunk);
+    }
 
-        void* chunk = m_first;
-        m_first = next(m_first);
-        return chunk;
+    std::size_t try_allocate_n(const ChunkArray& array, void** chunks,
+                               std::size_t n) noexcept
+    {
+        std::size_t count = 0;
+        void* iter = first(array);
+        while (iter != 0 && count < n)
+        {
+            chunks[count++] = iter;
+            iter = chunk_link(iter);
+        }
+        set_first(array, iter);
+
+        while (count < n && m_numTouched != array.numChunks)
+            chunks[count++] = array.chunk(m_numTouched++);
+        return count;
     }
 
-    void free(void* chunk) noexcept
+    void free_n(const ChunkArray& array, void** chunks, std::size_t n) noexcept
+    {
+        if (n == 0)
+            return;
+
+        for (std::size_t idx = 1; idx < n; ++idx)
+            chunk_link(chunks[idx - 1]) = chunks[idx];
+        chunk_link(chunks[n - 1]) = first(array);
+        set_first(array, chunks[0]);
+    }
+
+    //! Sorts the free chunks by address and calls \p f for every
+    //! allocated chunk.
+    template <typename TFunction>
+    void for_each_allocated(const ChunkArray& array, TFunction&& f)
     {
-        next(chunk) = m_first;
-        m_first = chunk;
+        void* sorted = sort_chunk_list(first(array));
+        set_first(array, sorted);
+        for_each_chunk_not_in(sorted, array.memory, array.chunkSize,
+                              m_numTouched, std::forward<TFunction>(f));
+    }
+
+    //! Returns all chunks to the list.
+    void clear() noexcept
+    {
+        m_first = 0;
+        m_numTouched = 0;
     }
 
 private:
-    //! Pointer to the first free block.
-    void* m_first;
+    //! The offset of the first free chunk plus one or zero, if the list
+    //! is empty.
+    std::size_t m_first;
+    //! The number of chunks, which have been handed out by the bump index.
+    std::size_t m_numTouched;
+
+    //! Returns the first free chunk or a null-pointer.
+    void* first(const ChunkArray& array) const noexcept
+    {
+        return m_first != 0 ? array.memory + (m_first - 1) : 0;
+    }
 
-    //! Returns a reference to the next pointer.
-    static void*& next(void* p)
+    //! Makes the \p chunk the first one in the list.
+    void set_first(const ChunkArray& array, void* chunk) noexcept
     {
-        return *static_cast<void**>(p);
+        m_first = chunk != 0 ? array.offset(chunk) + 1 : 0;
     }
 };
 
@@ -111,39 +604,41 @@ private:
 //! multiple threads, some kind of external synchronization (e.g. a mutex)
 //! has to be used. The shared_memory_pool might be an alternative in this
 //! case.
-template <typename TElement, std::size_t TNumElem>
+//!
+//! The optional \p TLayout determines the placement of the chunks. By
+//! default, the chunks are packed densely (compact_chunk_layout). With
+//! cacheline_aligned, every chunk starts on a new cache line. A
+//! handle_chunk_layout enables to_handle() and from_handle().
+template <typename TElement, std::size_t TNumElem,
+          typename TLayout = compact_chunk_layout>
 class memory_pool
+        : public weos_detail::PoolStatistics,
+          private weos_detail::PoolHandleTags<
+                      TNumElem, weos_detail::has_pool_handles<TLayout>::value>
 {
 public:
     //! The type of the elements stored in the pool.
     typedef TElement element_type;
+    //! The type of a handle to a chunk of this pool.
+    typedef pool_handle<element_type> handle_type;
 
 private:
     static_assert(TNumElem > 0, "The number of elements must be non-zero.");
 
-    // Every chunk has to be aligned such that it can contain either a
-    // void* or an element_type.
-    static const std::size_t chunk_align =
-            alignment_of<void*>::value > alignment_of<element_type>::value
-            ? alignment_of<void*>::value
-            : alignment_of<element_type>::value;
-    // The chunk size has to be large enough to store a void* or an element.
-    static const std::size_t chunk_size =
-            sizeof(void*) > sizeof(element_type)
-            ? sizeof(void*)
-            : sizeof(element_type);
+    typedef typename weos_detail::PoolChunk<element_type, TLayout>::type chunk_type;
 
-    // One chunk must be large enough for a void* or an element_type and it
-    // must be aligned to the stricter of both. Furthermore, the alignment
-    // must be a multiple of the size. The aligned_storage<> takes care
-    // of this.
-    typedef typename aligned_storage<chunk_size, chunk_align>::type chunk_type;
+    static const bool has_handles = weos_detail::has_pool_handles<TLayout>::value;
 
 public:
     //! Creates a memory pool.
-    //! Creates a memory pool with statically allocated storage.
-    memory_pool() noexcept
-        : m_list(&m_chunks[0], sizeof(chunk_type), TNumElem)
+    //! Creates a memory pool with statically allocated storage. The
+    //! constructor runs in constant time and is a constant expression. The
+    //! pool does not store pointers to itself. Thus, a pool with static
+    //! storage duration is placed in the .bss section and does not need any
+    //! run-time initialization. For a pool with automatic or dynamic storage
+    //! duration, the compiler may zero the whole object.
+    constexpr memory_pool() noexcept
+        : m_uninitialized()
     {
     }
 
@@ -161,7 +656,7 @@ public:
     //! Returns \p true, if the memory pool is empty.
     bool empty() const noexcept
     {
-        return m_list.empty();
+        return m_list.empty(chunk_array());
     }
 
     //! Allocates a chunk from the pool.
@@ -171,7 +666,9 @@ public:
     //! \sa free()
     void* try_allocate() noexcept
     {
-        return m_list.try_allocate();
+        void* chunk = m_list.try_allocate(chunk_array());
+        this->record_allocation(chunk);
+        return chunk;
     }
 
     //! Frees a previously allocated chunk.
@@ -181,21 +678,445 @@ public:
     //! \sa allocate()
     void free(void* chunk) noexcept
     {
-        m_list.free(chunk);
+        if (has_handles)
+            this->advance_tag(index_of(chunk));
+        m_list.free(chunk_array(), chunk);
+        this->record_free();
+    }
+
+    //! Allocates multiple chunks from the pool.
+    //! Allocates up to \p n chunks and stores pointers to them in the
+    //! array \p chunks. The method returns the number of allocated chunks,
+    //! which is less than \p n if the pool runs empty.
+    //!
+    //! \sa free_n()
+    std::size_t try_allocate_n(void** chunks, std::size_t n) noexcept
+    {
+        std::size_t count = m_list.try_allocate_n(chunk_array(), chunks, n);
+        this->record_allocations(n, count);
+        return count;
+    }
+
+    //! Frees multiple chunks.
+    //! Returns the \p n chunks in the array \p chunks back to the pool.
+    //! All of them must have been allocated from this pool.
+    //!
+    //! \sa try_allocate_n()
+    void free_n(void** chunks, std::size_t n) noexcept
+    {
+        if (has_handles)
+        {
+            for (std::size_t idx = 0; idx < n; ++idx)
+                this->advance_tag(index_of(chunks[idx]));
+        }
+        m_list.free_n(chunk_array(), chunks, n);
+        this->record_free(n);
+    }
+
+    //! Iterates over the allocated chunks.
+    //! Calls \p f for every allocated chunk in the order of increasing
+    //! addresses. The function is passed a void pointer to the chunk. It may
+    //! free the chunk but it must not allocate from the pool.
+    //!
+    //! In order to find the allocated chunks, the free-list is sorted by
+    //! address first. Thus, the iteration takes O(F log F + N) steps for F
+    //! free chunks and N chunks which have been allocated at least once.
+    template <typename TFunction>
+    void for_each_allocated(TFunction&& f)
+    {
+        m_list.for_each_allocated(chunk_array(), std::forward<TFunction>(f));
+    }
+
+    //! Frees all chunks.
+    //! Returns all chunks to the pool in constant time. With a
+    //! handle_chunk_layout, the generation tags of all chunks are advanced
+    //! in addition, which invalidates all handles and takes linear time.
+    void clear() noexcept
+    {
+        this->advance_all_tags();
+        m_list.clear();
+        this->record_clear();
+    }
+
+    //! Converts a chunk to a handle.
+    //! Returns a compact handle to the allocated \p chunk. The handle stays
+    //! valid until the chunk is freed. The pool must use a
+    //! handle_chunk_layout.
+    //!
+    //! \sa from_handle()
+    handle_type to_handle(const void* chunk) const noexcept
+    {
+        static_assert(has_handles,
+                      "Handles need a pool with a handle_chunk_layout.");
+        static_assert(TNumElem <= handle_type::max_chunks,
+                      "The pool is too large for handles.");
+
+        std::size_t index = index_of(chunk);
+        return handle_type(index, this->tag(index));
+    }
+
+    //! Converts a handle to a chunk.
+    //! Returns a pointer to the chunk to which the handle \p h refers. If
+    //! the handle is null or stale, i.e. the chunk has been freed in the
+    //! meantime, a null-pointer is returned.
+    //!
+    //! \sa to_handle()
+    void* from_handle(handle_type h) const noexcept
+    {
+        static_assert(has_handles,
+                      "Handles need a pool with a handle_chunk_layout.");
+
+        std::uint32_t index = h.index();
+        if (index >= TNumElem || h.tag() != this->tag(index))
+            return 0;
+        return const_cast<chunk_type*>(&m_chunks[index]);
     }
 
 private:
     //! The memory chunks for the elements and the free-list pointers.
-    chunk_type m_chunks[TNumElem];
+    //! The constructor initializes the dummy instead of the chunks, so that
+    //! the chunks are not filled at run-time.
+    union
+    {
+        char m_uninitialized;
+        chunk_type m_chunks[TNumElem];
+    };
+
+    //! The free-list.
+    weos_detail::FreeList m_list;
+
+    //! Returns the chunks, which are managed by the free-list.
+    weos_detail::ChunkArray chunk_array() const noexcept
+    {
+        return weos_detail::ChunkArray{
+                   reinterpret_cast<char*>(const_cast<chunk_type*>(m_chunks)),
+                   sizeof(chunk_type), TNumElem};
+    }
+
+    //! Returns the index of the \p chunk.
+    std::size_t index_of(const void* chunk) const noexcept
+    {
+        std::size_t index = static_cast<const chunk_type*>(chunk) - &m_chunks[0];
+        WEOS_ASSERT(index < TNumElem);
+        return index;
+    }
+};
+
+//! A memory pool with run-time configurable storage.
+//! The dynamic_memory_pool manages a block of memory, which is provided by
+//! the caller upon construction. In contrast to the memory_pool, the size
+//! and alignment of the chunks as well as the number of chunks are
+//! determined at run-time. As the pool does not depend on the element type,
+//! pools of different sizes share the same code.
+//!
+//! The dynamic_memory_pool does not own the memory. The caller has to
+//! ensure that the memory outlives the pool.
+//!
+//! The dynamic_memory_pool is not thread-safe. If it is simultaneously
+//! accessed from multiple threads, some kind of external synchronization
+//! (e.g. a mutex) has to be used.
+class dynamic_memory_pool : public weos_detail::PoolStatistics
+{
+public:
+    //! Creates a memory pool.
+    //! Creates a memory pool, which carves chunks from the \p memorySize
+    //! bytes of storage starting at \p memory. Every chunk is large enough
+    //! to hold \p chunkSize bytes and is aligned to \p chunkAlignment, which
+    //! must be a power of two.
+    dynamic_memory_pool(void* memory, std::size_t memorySize,
+                        std::size_t chunkSize,
+                        std::size_t chunkAlignment) noexcept
+        : m_chunkSize(aligned_chunk_size(chunkSize, chunkAlignment)),
+          m_capacity(num_chunks(memory, memorySize, m_chunkSize,
+                                chunkAlignment)),
+          m_memory(m_capacity != 0
+                   ? static_cast<char*>(align_up(memory, chunkAlignment))
+                   : 0)
+    {
+    }
+
+    dynamic_memory_pool(const dynamic_memory_pool&) = delete;
+    dynamic_memory_pool& operator= (const dynamic_memory_pool&) = delete;
+
+    //! Returns the number of pool elements.
+    //! Returns the number of chunks which have been carved from the memory.
+    std::size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    //! Returns the size of a chunk.
+    //! Returns the size of a chunk in bytes. This is the requested chunk size
+    //! rounded up to a multiple of the alignment.
+    std::size_t chunk_size() const noexcept
+    {
+        return m_chunkSize;
+    }
+
+    //! Checks if the memory pool is empty.
+    //! Returns \p true, if the memory pool is empty.
+    bool empty() const noexcept
+    {
+        return m_list.empty(chunk_array());
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates one chunk from the memory pool and returns a pointer to it.
+    //! If the pool is already empty, a null-pointer is returned.
+    //!
+    //! \sa free()
+    void* try_allocate() noexcept
+    {
+        void* chunk = m_list.try_allocate(chunk_array());
+        this->record_allocation(chunk);
+        return chunk;
+    }
+
+    //! Frees a previously allocated chunk.
+    //! Returns a \p chunk which must have been allocated via try_allocate()
+    //! back to the pool.
+    //!
+    //! \sa try_allocate()
+    void free(void* chunk) noexcept
+    {
+        m_list.free(chunk_array(), chunk);
+        this->record_free();
+    }
+
+    //! Allocates multiple chunks from the pool.
+    //! Allocates up to \p n chunks and stores pointers to them in the
+    //! array \p chunks. The method returns the number of allocated chunks,
+    //! which is less than \p n if the pool runs empty.
+    //!
+    //! \sa free_n()
+    std::size_t try_allocate_n(void** chunks, std::size_t n) noexcept
+    {
+        std::size_t count = m_list.try_allocate_n(chunk_array(), chunks, n);
+        this->record_allocations(n, count);
+        return count;
+    }
+
+    //! Frees multiple chunks.
+    //! Returns the \p n chunks in the array \p chunks back to the pool.
+    //! All of them must have been allocated from this pool.
+    //!
+    //! \sa try_allocate_n()
+    void free_n(void** chunks, std::size_t n) noexcept
+    {
+        m_list.free_n(chunk_array(), chunks, n);
+        this->record_free(n);
+    }
 
+private:
+    //! The size of a chunk.
+    std::size_t m_chunkSize;
+    //! The number of chunks.
+    std::size_t m_capacity;
+    //! The start of the first chunk.
+    char* m_memory;
     //! The free-list.
     weos_detail::FreeList m_list;
+
+    //! Returns the chunks, which are managed by the free-list.
+    weos_detail::ChunkArray chunk_array() const noexcept
+    {
+        return weos_detail::ChunkArray{m_memory, m_chunkSize, m_capacity};
+    }
+
+    //! Returns the size of a chunk, which can hold either a void* or
+    //! \p size bytes and is a multiple of the \p alignment.
+    static std::size_t aligned_chunk_size(std::size_t size,
+                                          std::size_t alignment) noexcept
+    {
+        WEOS_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+        if (alignment < alignment_of<void*>::value)
+            alignment = alignment_of<void*>::value;
+        if (size < sizeof(void*))
+            size = sizeof(void*);
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    //! Returns the first address in \p memory which has the given
+    //! \p alignment.
+    static void* align_up(void* memory, std::size_t alignment) noexcept
+    {
+        if (alignment < alignment_of<void*>::value)
+            alignment = alignment_of<void*>::value;
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(memory);
+        address = (address + alignment - 1) & ~std::uintptr_t(alignment - 1);
+        return reinterpret_cast<void*>(address);
+    }
+
+    //! Returns the number of chunks of size \p chunkSize which fit into
+    //! the \p memory after it has been aligned.
+    static std::size_t num_chunks(void* memory, std::size_t memorySize,
+                                  std::size_t chunkSize,
+                                  std::size_t alignment) noexcept
+    {
+        std::size_t padding = static_cast<char*>(align_up(memory, alignment))
+                              - static_cast<char*>(memory);
+        return memorySize > padding ? (memorySize - padding) / chunkSize : 0;
+    }
+};
+
+//! A memory pool with a bitmap index.
+//! A bitmap_memory_pool provides storage for (\p TNumElem) elements of
+//! type \p TElement, which is allocated statically. In contrast to the
+//! memory_pool, it does not keep a free-list in the chunks but stores the
+//! state of every chunk in a bit of a bitmap. Allocating a chunk searches the
+//! bitmap for the first free chunk using a find-first-set instruction.
+//!
+//! As the chunks are not written when they are freed, they stay cold in the
+//! cache and do not need to be large enough for a pointer. Furthermore, the
+//! pool knows which chunks are allocated, which allows to iterate over them
+//! with for_each_allocated().
+//!
+//! The bitmap_memory_pool is not thread-safe. If it is simultaneously accessed
+//! from multiple threads, some kind of external synchronization (e.g. a
+//! mutex) has to be used.
+template <typename TElement, std::size_t TNumElem>
+class bitmap_memory_pool : public weos_detail::PoolStatistics
+{
+public:
+    //! The type of the elements stored in the pool.
+    typedef TElement element_type;
+
+private:
+    static_assert(TNumElem > 0, "The number of elements must be non-zero.");
+
+    typedef typename aligned_storage<sizeof(element_type),
+                                     alignment_of<element_type>::value>::type chunk_type;
+
+    static const std::size_t bits_per_word = 32;
+    static const std::size_t num_words = (TNumElem + bits_per_word - 1)
+                                         / bits_per_word;
+
+public:
+    //! Creates a memory pool.
+    //! Creates a memory pool with statically allocated storage.
+    bitmap_memory_pool() noexcept
+        : m_firstCandidate(0)
+    {
+        for (std::size_t idx = 0; idx < num_words; ++idx)
+            m_free[idx] = ~std::uint32_t(0);
+        // Mark the bits beyond the last chunk as allocated.
+        if (TNumElem % bits_per_word)
+            m_free[num_words - 1] = (std::uint32_t(1) << (TNumElem % bits_per_word)) - 1;
+    }
+
+    bitmap_memory_pool(const bitmap_memory_pool&) = delete;
+    bitmap_memory_pool& operator= (const bitmap_memory_pool&) = delete;
+
+    //! Returns the number of pool elements.
+    //! Returns the number of elements for which the pool provides memory.
+    std::size_t capacity() const noexcept
+    {
+        return TNumElem;
+    }
+
+    //! Checks if the memory pool is empty.
+    //! Returns \p true, if the memory pool is empty.
+    bool empty() const noexcept
+    {
+        for (std::size_t idx = m_firstCandidate; idx < num_words; ++idx)
+            if (m_free[idx])
+                return false;
+        return true;
+    }
+
+    //! Allocates a chunk from the pool.
+    //! Allocates the free chunk with the lowest address and returns a pointer
+    //! to it. If the pool is already empty, a null-pointer is returned.
+    //!
+    //! \sa free()
+    void* try_allocate() noexcept
+    {
+        // All words before m_firstCandidate are known to be zero.
+        for (; m_firstCandidate < num_words; ++m_firstCandidate)
+        {
+            std::uint32_t word = m_free[m_firstCandidate];
+            if (word)
+            {
+                unsigned bit = weos_detail::count_trailing_zeros(word);
+                m_free[m_firstCandidate] = word & ~(std::uint32_t(1) << bit);
+                void* chunk = &m_chunks[m_firstCandidate * bits_per_word + bit];
+                this->record_allocation(chunk);
+                return chunk;
+            }
+        }
+        this->record_allocation(0);
+        return 0;
+    }
+
+    //! Frees a previously allocated chunk.
+    //! Returns a \p chunk which must have been allocated via try_allocate()
+    //! back to the pool.
+    //!
+    //! \sa try_allocate()
+    void free(void* chunk) noexcept
+    {
+        std::size_t index = static_cast<chunk_type*>(chunk) - &m_chunks[0];
+        WEOS_ASSERT(index < TNumElem);
+        std::size_t word = index / bits_per_word;
+        std::uint32_t mask = std::uint32_t(1) << (index % bits_per_word);
+        WEOS_ASSERT((m_free[word] & mask) == 0);
+        m_free[word] |= mask;
+        if (word < m_firstCandidate)
+            m_firstCandidate = word;
+        this->record_free();
+    }
+
+    //! Checks if a chunk is allocated.
+    //! Returns \p true, if the \p chunk, which must belong to this pool,
+    //! is allocated.
+    bool is_allocated(const void* chunk) const noexcept
+    {
+        std::size_t index = static_cast<const chunk_type*>(chunk) - &m_chunks[0];
+        WEOS_ASSERT(index < TNumElem);
+        return (m_free[index / bits_per_word]
+                & (std::uint32_t(1) << (index % bits_per_word))) == 0;
+    }
+
+    //! Iterates over the allocated chunks.
+    //! Calls \p f for every allocated chunk in the order of increasing
+    //! addresses. The function is passed a void pointer to the chunk. It may
+    //! free the chunk but it must not allocate from the pool. The cost of
+    //! the iteration is proportional to the capacity divided by 32 plus the
+    //! number of allocated chunks.
+    template <typename TFunction>
+    void for_each_allocated(TFunction&& f)
+    {
+        for (std::size_t idx = 0; idx < num_words; ++idx)
+        {
+            std::uint32_t allocated = ~m_free[idx];
+            if (idx == num_words - 1 && TNumElem % bits_per_word)
+                allocated &= (std::uint32_t(1) << (TNumElem % bits_per_word)) - 1;
+
+            while (allocated)
+            {
+                unsigned bit = weos_detail::count_trailing_zeros(allocated);
+                allocated &= allocated - 1;
+                f(static_cast<void*>(&m_chunks[idx * bits_per_word + bit]));
+            }
+        }
+    }
+
+private:
+    //! The memory chunks for the elements.
+    chunk_type m_chunks[TNumElem];
+    //! A bitmap with a set bit for every free chunk.
+    std::uint32_t m_free[num_words];
+    //! The index of the first word in the bitmap, which might have a set bit.
+    std::size_t m_firstCandidate;
 };
 
 WEOS_END_NAMESPACE
 
 
-#if defined(WEOS_WRAP_CMSIS_RTOS)
+#if defined(WEOS_WRAP_CXX11)
+    #include "_cxx11/_memorypool.hpp"
+#elif defined(WEOS_WRAP_CMSIS_RTOS)
     #include "_cmsis_rtos/memorypool.hpp"
 #else
     #error "Invalid native OS."
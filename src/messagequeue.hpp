@@ -31,7 +31,9 @@
 
 #include "_config.hpp"
 
-#if defined(WEOS_WRAP_CMSIS_RTOS)
+#if defined(WEOS_WRAP_CXX11)
+    #include "_cxx11/_messagequeue.hpp"
+#elif defined(WEOS_WRAP_CMSIS_RTOS)
     #include "_cmsis_rtos/messagequeue.hpp"
 #else
     #error "Invalid native OS."
@@ -31,12 +31,88 @@
 
 #include "_config.hpp"
 
-#inlcude "memory.hpp"
+#include "atomic.hpp"
+#include "chrono.hpp"
+#include "intrusive_ptr.hpp"
+#include "memory.hpp"
 #include "memorypool.hpp"
+#include "type_traits.hpp"
+
+#include <cstdint>
 
 
 WEOS_BEGIN_NAMESPACE
 
+template <typename TElement, std::size_t TNumElem, typename TLayout>
+class object_pool;
+
+template <typename TElement, std::size_t TNumElem, typename TLayout>
+class shared_object_pool;
+
+//! A base class for reference-counted pool objects.
+//! An object of a type which publicly derives from pool_ref_counted can be
+//! created with make_intrusive() of an object_pool or a shared_object_pool.
+//! The object is managed by an intrusive_ptr. The reference count and the
+//! information which is needed to return the object to its pool are stored
+//! in the object itself, i.e. in the pool chunk. When the last intrusive_ptr
+//! is released, the object is destroyed and its chunk is returned to the
+//! pool. The reference count is atomic.
+class pool_ref_counted
+{
+public:
+    pool_ref_counted() noexcept
+        : m_refCount(0),
+          m_pool(0),
+          m_release(0)
+    {
+    }
+
+    // A copy is a new object, which is not referenced yet.
+    pool_ref_counted(const pool_ref_counted&) noexcept
+        : m_refCount(0),
+          m_pool(0),
+          m_release(0)
+    {
+    }
+
+    pool_ref_counted& operator=(const pool_ref_counted&) noexcept
+    {
+        return *this;
+    }
+
+    friend
+    void intrusive_ptr_add_ref(pool_ref_counted* object) noexcept
+    {
+        object->m_refCount.fetch_add(1, memory_order_relaxed);
+    }
+
+    friend
+    void intrusive_ptr_release_ref(pool_ref_counted* object) noexcept
+    {
+        if (object->m_refCount.fetch_sub(1, memory_order_acq_rel) == 1)
+        {
+            WEOS_ASSERT(object->m_release);
+            object->m_release(object->m_pool, object);
+        }
+    }
+
+protected:
+    ~pool_ref_counted() = default;
+
+private:
+    //! The number of intrusive pointers which reference this object.
+    atomic<std::uint32_t> m_refCount;
+    //! The pool from which the object has been allocated.
+    void* m_pool;
+    //! Destroys the object and returns its memory to the pool.
+    void (*m_release)(void* pool, pool_ref_counted* object);
+
+    template <typename TElement, std::size_t TNumElem, typename TLayout>
+    friend class object_pool;
+    template <typename TElement, std::size_t TNumElem, typename TLayout>
+    friend class shared_object_pool;
+};
+
 //! An object pool with static (compile-time) storage.
 //!
 //! The object_pool is a memory pool for (\p TNumElem) objects of
@@ -47,10 +123,13 @@ WEOS_BEGIN_NAMESPACE
 //! constructor is invoked using a placement new. Upon destruction, the
 //! element's destructor is called before the memory is returned back to the
 //! pool.
-template <typename TElement, std::size_t TNumElem>
+//!
+//! The chunk layout \p TLayout is passed on to the memory_pool.
+template <typename TElement, std::size_t TNumElem,
+          typename TLayout = compact_chunk_layout>
 class object_pool
 {
-    typedef memory_pool<TElement, TNumElem> memory_pool_t;
+    typedef memory_pool<TElement, TNumElem, TLayout> memory_pool_t;
 
     struct Deleter
     {
@@ -73,20 +152,48 @@ class object_pool
 public:
     //! The type of the elements which can be allocated via this pool.
     typedef TElement element_type;
+    //! The type of a handle to an element of this pool.
+    typedef pool_handle<element_type> handle_type;
+
+    //! The deleter of the unique pointers, which are created by
+    //! make_unique(). It destroys the element and returns its memory to
+    //! the pool.
+    class element_deleter
+    {
+    public:
+        element_deleter() noexcept
+            : m_pool(0)
+        {
+        }
+
+        explicit
+        element_deleter(object_pool& pool) noexcept
+            : m_pool(&pool)
+        {
+        }
+
+        void operator()(element_type* element) const noexcept
+        {
+            m_pool->destroy(element);
+        }
+
+    private:
+        object_pool* m_pool;
+    };
+
+    //! A unique pointer to an element of this pool.
+    typedef unique_ptr<element_type, element_deleter> unique_pointer;
 
     object_pool() = default;
 
     object_pool(const object_pool&) = delete;
     object_pool& operator=(const object_pool&) = delete;
 
+    //! Destroys the pool.
+    //! Destroys the pool and all objects which are still alive.
     ~object_pool()
     {
-        //! \todo 1. order the free list (insert an order() function into
-        //!          the storage
-        //!       2. traverse the ordered free list - if the 'next'-pointer
-        //!          does not point to the following chunk, the chunk is
-        //!          occupied by a live object whose destructor needs to be
-        //!          called
+        clear();
     }
 
     //! Returns the pool's capacity.
@@ -104,6 +211,14 @@ public:
         return m_memoryPool.empty();
     }
 
+#if defined(WEOS_ENABLE_POOL_STATISTICS)
+    //! Returns the allocation statistics of this pool.
+    pool_statistics statistics() const noexcept
+    {
+        return m_memoryPool.statistics();
+    }
+#endif // WEOS_ENABLE_POOL_STATISTICS
+
     //! Allocates and constructs an object.
     //! Allocates memory for an object and calls its constructor. The method
     //! returns a pointer to the newly created object or a null-pointer if no
@@ -119,6 +234,43 @@ public:
         return static_cast<element_type*>(mem.release());
     }
 
+    //! Constructs an object owned by a unique pointer.
+    //! Allocates memory for an object and calls its constructor with the
+    //! given \p args. The object is returned in a unique pointer, whose
+    //! deleter destroys the object and returns its memory to this pool. If no
+    //! memory is available, an empty pointer is returned.
+    template <typename... TArgs>
+    unique_pointer make_unique(TArgs&&... args)
+    {
+        return unique_pointer(try_construct(std::forward<TArgs>(args)...),
+                              element_deleter(*this));
+    }
+
+    //! Constructs a reference-counted object.
+    //! Allocates memory for an object and calls its constructor with the
+    //! given \p args. The object is managed by the returned intrusive
+    //! pointer. Its reference count is kept in the object itself, which
+    //! requires that \p element_type publicly derives from
+    //! pool_ref_counted. When the last pointer is released, the object
+    //! is destroyed and its memory is returned to this pool. If no memory
+    //! is available, an empty pointer is returned.
+    template <typename... TArgs>
+    intrusive_ptr<element_type> make_intrusive(TArgs&&... args)
+    {
+        static_assert(is_base_of<pool_ref_counted, element_type>::value,
+                      "The element type must derive from pool_ref_counted.");
+
+        element_type* element = try_construct(std::forward<TArgs>(args)...);
+        if (!element)
+            return intrusive_ptr<element_type>();
+
+        pool_ref_counted* counted = element;
+        counted->m_refCount.store(1, memory_order_relaxed);
+        counted->m_pool = this;
+        counted->m_release = &release_ref_counted;
+        return intrusive_ptr<element_type>(element, keep_reference_count);
+    }
+
     //! Destroys an element.
     //! Destroys the \p element whose memory must have been allocated via
     //! this object pool and whose constructor must have been called.
@@ -128,9 +280,68 @@ public:
         m_memoryPool.free(element);
     }
 
+    //! Iterates over the live objects.
+    //! Calls \p f for every object which has been constructed in this pool
+    //! and not yet destroyed. The objects are passed as \p element_type& in
+    //! the order of increasing addresses. \p f may destroy the object, which
+    //! is passed to it, but it must not construct new objects.
+    //!
+    //! The iteration sorts the list of free chunks by address and then
+    //! walks over the chunks. It takes O(F log F + N) steps for F free chunks
+    //! and N chunks which have been in use at least once.
+    template <typename TFunction>
+    void for_each_live(TFunction&& f)
+    {
+        m_memoryPool.for_each_allocated([&f](void* chunk) {
+            f(*static_cast<element_type*>(chunk));
+        });
+    }
+
+    //! Destroys all objects.
+    //! Calls the destructor of every live object and returns the whole
+    //! memory to the pool. This is considerably faster than calling
+    //! destroy() for every object.
+    void clear() noexcept
+    {
+        m_memoryPool.for_each_allocated([](void* chunk) {
+            static_cast<element_type*>(chunk)->~element_type();
+        });
+        m_memoryPool.clear();
+    }
+
+    //! Converts an element to a handle.
+    //! Returns a compact handle to the live \p element. The handle stays
+    //! valid until the element is destroyed. As the handle is a 32-bit
+    //! value, it can be sent through a message_queue more efficiently than
+    //! the element itself. The pool must use a handle_chunk_layout.
+    //!
+    //! \sa from_handle()
+    handle_type to_handle(const element_type* element) const noexcept
+    {
+        return m_memoryPool.to_handle(element);
+    }
+
+    //! Converts a handle to an element.
+    //! Returns a pointer to the element to which the handle \p h refers.
+    //! If the handle is null or the element has been destroyed in the
+    //! meantime, a null-pointer is returned.
+    //!
+    //! \sa to_handle()
+    element_type* from_handle(handle_type h) const noexcept
+    {
+        return static_cast<element_type*>(m_memoryPool.from_handle(h));
+    }
+
 private:
     //! The pool from which the memory for the elements is allocated.
     memory_pool_t m_memoryPool;
+
+    //! Destroys the reference-counted \p object, which belongs to the
+    //! \p pool.
+    static void release_ref_counted(void* pool, pool_ref_counted* object) noexcept
+    {
+        static_cast<object_pool*>(pool)->destroy(static_cast<element_type*>(object));
+    }
 };
 
 //! A shared object pool.
@@ -140,11 +351,13 @@ private:
 //! held internally, i.e. no memory is allocated dynamically.
 //!
 //! As the shared_object_pool uses a shared_memory_pool internally, it is
-//! thread-safe.
-template <typename TElement, std::size_t TNumElem>
+//! thread-safe. The chunk layout \p TLayout is passed on to the
+//! shared_memory_pool.
+template <typename TElement, std::size_t TNumElem,
+          typename TLayout = compact_chunk_layout>
 class shared_object_pool
 {
-    typedef shared_memory_pool<TElement, TNumElem> memory_pool_t;
+    typedef shared_memory_pool<TElement, TNumElem, TLayout> memory_pool_t;
 
     struct Deleter
     {
@@ -168,14 +381,45 @@ public:
     //! The type of the elements which can be allocated via this pool.
     typedef TElement element_type;
 
+    //! The deleter of the unique pointers, which are created by
+    //! make_unique(). It destroys the element and returns its memory to
+    //! the pool.
+    class element_deleter
+    {
+    public:
+        element_deleter() noexcept
+            : m_pool(0)
+        {
+        }
+
+        explicit
+        element_deleter(shared_object_pool& pool) noexcept
+            : m_pool(&pool)
+        {
+        }
+
+        void operator()(element_type* element) const noexcept
+        {
+            m_pool->destroy(element);
+        }
+
+    private:
+        shared_object_pool* m_pool;
+    };
+
+    //! A unique pointer to an element of this pool.
+    typedef unique_ptr<element_type, element_deleter> unique_pointer;
+
     shared_object_pool() = default;
 
     shared_object_pool(const shared_object_pool&) = delete;
     shared_object_pool& operator=(const shared_object_pool&) = delete;
 
+    //! Destroys the pool.
+    //! Destroys the pool and all objects which are still alive.
     ~shared_object_pool()
     {
-        //! \todo Sort and delete the objects
+        clear();
     }
 
     //! Returns the pool's capacity.
@@ -192,11 +436,13 @@ public:
         return m_memoryPool.empty();
     }
 
-    //! Returns the number of available elements.
-    std::size_t size() const noexcept
+#if defined(WEOS_ENABLE_POOL_STATISTICS)
+    //! Returns the allocation statistics of this pool.
+    pool_statistics statistics() const noexcept
     {
-        return m_memoryPool.size();
+        return m_memoryPool.statistics();
     }
+#endif // WEOS_ENABLE_POOL_STATISTICS
 
     //! Constructs an object.
     //! Allocates memory and constructs an element in it. The method
@@ -234,9 +480,9 @@ public:
     //! expires. In the latter case, a null-pointer is returned.
     template <typename RepT, typename PeriodT, typename... TArgs>
     element_type* try_construct_for(const chrono::duration<RepT, PeriodT>& d,
-                                    TArgs... args)
+                                    TArgs&&... args)
     {
-        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate(),
+        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate_for(d),
                                       Deleter(m_memoryPool));
         if (!mem)
             return 0;
@@ -244,6 +490,61 @@ public:
         return static_cast<element_type*>(mem.release());
     }
 
+    //! Tries to construct an object with timeout.
+    //! Tries to allocate memory and constructs an element in it. Then
+    //! a pointer to the newly constructed element is returned. If no memory
+    //! is available in the pool, the calling thread is blocked until either
+    //! a memory block becomes available or the point in time \p time has
+    //! been reached. In the latter case, a null-pointer is returned.
+    template <typename ClockT, typename DurationT, typename... TArgs>
+    element_type* try_construct_until(const chrono::time_point<ClockT, DurationT>& time,
+                                      TArgs&&... args)
+    {
+        unique_ptr<void, Deleter> mem(m_memoryPool.try_allocate_until(time),
+                                      Deleter(m_memoryPool));
+        if (!mem)
+            return 0;
+        new (mem.get()) element_type(std::forward<TArgs>(args)...);
+        return static_cast<element_type*>(mem.release());
+    }
+
+    //! Constructs an object owned by a unique pointer.
+    //! Allocates memory for an object and calls its constructor with the
+    //! given \p args. The object is returned in a unique pointer, whose
+    //! deleter destroys the object and returns its memory to this pool. If no
+    //! memory is available, an empty pointer is returned.
+    template <typename... TArgs>
+    unique_pointer make_unique(TArgs&&... args)
+    {
+        return unique_pointer(try_construct(std::forward<TArgs>(args)...),
+                              element_deleter(*this));
+    }
+
+    //! Constructs a reference-counted object.
+    //! Allocates memory for an object and calls its constructor with the
+    //! given \p args. The object is managed by the returned intrusive
+    //! pointer. Its reference count is kept in the object itself, which
+    //! requires that \p element_type publicly derives from
+    //! pool_ref_counted. When the last pointer is released, the object
+    //! is destroyed and its memory is returned to this pool. If no memory
+    //! is available, an empty pointer is returned.
+    template <typename... TArgs>
+    intrusive_ptr<element_type> make_intrusive(TArgs&&... args)
+    {
+        static_assert(is_base_of<pool_ref_counted, element_type>::value,
+                      "The element type must derive from pool_ref_counted.");
+
+        element_type* element = try_construct(std::forward<TArgs>(args)...);
+        if (!element)
+            return intrusive_ptr<element_type>();
+
+        pool_ref_counted* counted = element;
+        counted->m_refCount.store(1, memory_order_relaxed);
+        counted->m_pool = this;
+        counted->m_release = &release_ref_counted;
+        return intrusive_ptr<element_type>(element, keep_reference_count);
+    }
+
     //! Destroys an element.
     //! Destroys the \p element whose memory must have been allocated via
     //! this object pool. The destructor of \p element is called before
@@ -256,9 +557,51 @@ public:
         m_memoryPool.free(element);
     }
 
+    //! Iterates over the live objects.
+    //! Calls \p f for every object which has been constructed in this pool
+    //! and not yet destroyed. The objects are passed as \p element_type& in
+    //! the order of increasing addresses. \p f may destroy the object, which
+    //! is passed to it, but it must not construct new objects.
+    //!
+    //! The iteration sorts the list of free chunks by address and then
+    //! walks over the chunks. It takes O(F log F + N) steps for F free chunks
+    //! and N chunks which have been in use at least once.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool concurrently.
+    template <typename TFunction>
+    void for_each_live(TFunction&& f)
+    {
+        m_memoryPool.for_each_allocated([&f](void* chunk) {
+            f(*static_cast<element_type*>(chunk));
+        });
+    }
+
+    //! Destroys all objects.
+    //! Calls the destructor of every live object and returns the whole
+    //! memory to the pool. This is considerably faster than calling
+    //! destroy() for every object.
+    //!
+    //! \note This method is not thread-safe. No other thread may access the
+    //! pool concurrently.
+    void clear() noexcept
+    {
+        m_memoryPool.for_each_allocated([](void* chunk) {
+            static_cast<element_type*>(chunk)->~element_type();
+        });
+        m_memoryPool.clear();
+    }
+
 private:
     //! The pool from which the memory for the elements is allocated.
     memory_pool_t m_memoryPool;
+
+    //! Destroys the reference-counted \p object, which belongs to the
+    //! \p pool.
+    static void release_ref_counted(void* pool, pool_ref_counted* object) noexcept
+    {
+        static_cast<shared_object_pool*>(pool)->destroy(static_cast<element_type*>(object));
+    }
 };
 
 WEOS_END_NAMESPACE
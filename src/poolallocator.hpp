@@ -0,0 +1,410 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_POOLALLOCATOR_HPP
+#define WEOS_POOLALLOCATOR_HPP
+
+#include "_config.hpp"
+
+#include "memorypool.hpp"
+#include "system_error.hpp"
+#include "tuple.hpp"
+#include "type_traits.hpp"
+#include "utility.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A size class of a pool allocator set.
+//! A size_class describes a pool of (\p TNumElem) chunks, each of which can
+//! hold \p TSize bytes aligned to \p TAlign. By default, the alignment is
+//! the strictest alignment of any type whose size is \p TSize.
+template <std::size_t TSize, std::size_t TNumElem,
+          std::size_t TAlign = alignment_of<
+                                   typename aligned_storage<TSize>::type>::value>
+struct size_class
+{
+    static_assert(TSize > 0, "The size must be non-zero.");
+
+    //! The size of a chunk.
+    static const std::size_t size = TSize;
+    //! The number of chunks.
+    static const std::size_t num_elements = TNumElem;
+    //! The alignment of a chunk.
+    static const std::size_t alignment = TAlign;
+
+    //! The element type with which the pool is instantiated.
+    typedef typename aligned_storage<TSize, TAlign>::type element_type;
+};
+
+namespace weos_detail
+{
+
+constexpr
+std::size_t greatest_common_divisor(std::size_t a, std::size_t b)
+{
+    return b == 0 ? a : greatest_common_divisor(b, a % b);
+}
+
+template <typename... TSizeClasses>
+struct SizeClassTraits;
+
+template <typename TSizeClass>
+struct SizeClassTraits<TSizeClass>
+{
+    static const std::size_t max_size = TSizeClass::size;
+    static const std::size_t granularity = TSizeClass::size;
+    static const bool is_sorted = true;
+
+    //! Returns the index of the first size class, which can hold \p size
+    //! bytes, offset by \p index.
+    static constexpr
+    std::size_t find(std::size_t size, std::size_t index)
+    {
+        return size <= TSizeClass::size ? index : index + 1;
+    }
+};
+
+template <typename TSizeClass, typename TNext, typename... TRest>
+struct SizeClassTraits<TSizeClass, TNext, TRest...>
+{
+    typedef SizeClassTraits<TNext, TRest...> tail;
+
+    static const std::size_t max_size = tail::max_size;
+    static const std::size_t granularity
+        = greatest_common_divisor(TSizeClass::size, tail::granularity);
+    static const bool is_sorted = TSizeClass::size < TNext::size
+                                  && tail::is_sorted;
+
+    static constexpr
+    std::size_t find(std::size_t size, std::size_t index)
+    {
+        return size <= TSizeClass::size ? index : tail::find(size, index + 1);
+    }
+};
+
+//! A table which maps a size to the index of a size class. The table has an
+//! entry per multiple of the granule \p TGranule. The k-th entry is the
+//! smallest size class which can hold (k - 1) * TGranule + 1 bytes, i.e. the
+//! smallest size of the k-th granule. If the granule is a divisor of all
+//! class sizes, this is the class for every size in the granule.
+template <typename TTraits, std::size_t TGranule, typename TSequence>
+struct SizeClassLookupTable;
+
+template <typename TTraits, std::size_t TGranule, std::size_t... TIndices>
+struct SizeClassLookupTable<TTraits, TGranule, index_sequence<TIndices...>>
+{
+    static constexpr std::uint8_t values[sizeof...(TIndices)]
+        = { std::uint8_t(TTraits::find(
+                TIndices == 0 ? 0 : (TIndices - 1) * TGranule + 1, 0))... };
+};
+
+template <typename TTraits, std::size_t TGranule, std::size_t... TIndices>
+constexpr std::uint8_t
+SizeClassLookupTable<TTraits, TGranule, index_sequence<TIndices...>>::values[sizeof...(TIndices)];
+
+//! Tables of functions to allocate from and free to the I-th pool of
+//! a tuple of pools.
+template <typename TPools, typename TSequence>
+struct PoolDispatchTable;
+
+template <typename TPools, std::size_t... TIndices>
+struct PoolDispatchTable<TPools, index_sequence<TIndices...>>
+{
+    template <std::size_t TIndex>
+    static void* allocate_from(TPools& pools) noexcept
+    {
+        return get<TIndex>(pools).try_allocate();
+    }
+
+    // Returns the chunk to the pool and returns true, if the chunk belongs
+    // to it. As all pools store their chunks internally, the chunk's
+    // address must lie within the pool object.
+    template <std::size_t TIndex>
+    static bool free_to(TPools& pools, void* chunk) noexcept
+    {
+        auto& pool = get<TIndex>(pools);
+        char* begin = reinterpret_cast<char*>(&pool);
+        if (static_cast<char*>(chunk) < begin
+            || static_cast<char*>(chunk) >= begin + sizeof(pool))
+        {
+            return false;
+        }
+
+        pool.free(chunk);
+        return true;
+    }
+
+    static constexpr void* (*allocate[sizeof...(TIndices)])(TPools&)
+        = { &allocate_from<TIndices>... };
+    static constexpr bool (*free[sizeof...(TIndices)])(TPools&, void*)
+        = { &free_to<TIndices>... };
+};
+
+template <typename TPools, std::size_t... TIndices>
+constexpr void* (*PoolDispatchTable<TPools, index_sequence<TIndices...>>::allocate[sizeof...(TIndices)])(TPools&);
+
+template <typename TPools, std::size_t... TIndices>
+constexpr bool (*PoolDispatchTable<TPools, index_sequence<TIndices...>>::free[sizeof...(TIndices)])(TPools&, void*);
+
+template <bool TShared, typename... TSizeClasses>
+class PoolAllocatorSet
+{
+    static_assert(sizeof...(TSizeClasses) > 0,
+                  "At least one size class is required.");
+    static_assert(sizeof...(TSizeClasses) < 256,
+                  "Too many size classes.");
+
+    typedef SizeClassTraits<TSizeClasses...> traits;
+    static_assert(traits::is_sorted,
+                  "The size classes must be sorted by increasing size.");
+
+    template <typename TSizeClass>
+    struct pool_type
+    {
+        typedef typename conditional<
+                    TShared,
+                    shared_memory_pool<typename TSizeClass::element_type,
+                                       TSizeClass::num_elements>,
+                    memory_pool<typename TSizeClass::element_type,
+                                TSizeClass::num_elements>>::type type;
+    };
+
+    typedef tuple<typename pool_type<TSizeClasses>::type...> pools_type;
+
+    //! The maximum number of entries in the lookup table.
+    static const std::size_t max_lookup_entries = 256;
+    //! The granule of the lookup table. It is the greatest common divisor
+    //! of the class sizes, unless this would make the table too large. Then
+    //! the granule is coarsened and first_class() finishes the lookup with
+    //! a linear search.
+    static const std::size_t granule
+        = traits::max_size / traits::granularity < max_lookup_entries
+          ? traits::granularity
+          : (traits::max_size + max_lookup_entries - 2) / (max_lookup_entries - 1);
+
+    typedef SizeClassLookupTable<
+                traits, granule,
+                make_index_sequence<(traits::max_size + granule - 1) / granule + 1>
+            > lookup_table;
+    static_assert(sizeof(lookup_table::values) <= max_lookup_entries,
+                  "The lookup table is too large.");
+    typedef PoolDispatchTable<
+                pools_type,
+                make_index_sequence<sizeof...(TSizeClasses)>
+            > dispatch_table;
+
+public:
+    //! The number of size classes.
+    static const std::size_t num_size_classes = sizeof...(TSizeClasses);
+    //! The size of the largest chunk.
+    static const std::size_t max_size = traits::max_size;
+
+    PoolAllocatorSet() = default;
+
+    PoolAllocatorSet(const PoolAllocatorSet&) = delete;
+    PoolAllocatorSet& operator=(const PoolAllocatorSet&) = delete;
+
+    //! Allocates memory.
+    //! Allocates a chunk of at least \p size bytes aligned to \p alignment
+    //! from the smallest size class which fits. If that class is exhausted,
+    //! the next larger classes are tried. If no chunk is available, a
+    //! null-pointer is returned.
+    void* allocate(std::size_t size, std::size_t alignment) noexcept
+    {
+        if (size > max_size)
+            return 0;
+
+        static constexpr std::size_t alignments[] = { TSizeClasses::alignment... };
+        for (std::size_t index = first_class(size);
+             index < num_size_classes; ++index)
+        {
+            if (alignment <= alignments[index])
+            {
+                void* chunk = dispatch_table::allocate[index](m_pools);
+                if (chunk)
+                    return chunk;
+            }
+        }
+        return 0;
+    }
+
+    //! Frees memory.
+    //! Returns the \p chunk, which must have been allocated with a size of
+    //! \p size bytes, to its pool.
+    void deallocate(void* chunk, std::size_t size) noexcept
+    {
+        WEOS_ASSERT(size <= max_size);
+
+        for (std::size_t index = first_class(size);
+             index < num_size_classes; ++index)
+        {
+            if (dispatch_table::free[index](m_pools, chunk))
+                return;
+        }
+        WEOS_ASSERT(0 && "The chunk does not belong to the pool allocator set.");
+    }
+
+private:
+    //! The pools of the size classes.
+    pools_type m_pools;
+
+    //! Returns the index of the smallest size class which can hold \p size
+    //! bytes.
+    static std::size_t first_class(std::size_t size) noexcept
+    {
+        static constexpr std::size_t sizes[] = { TSizeClasses::size... };
+        std::size_t index = lookup_table::values[(size + granule - 1) / granule];
+        // With a coarsened granule, the table yields the smallest class of
+        // the granule, which may be too small for this size.
+        while (sizes[index] < size)
+            ++index;
+        return index;
+    }
+};
+
+template <bool TShared, typename... TSizeClasses>
+const std::size_t PoolAllocatorSet<TShared, TSizeClasses...>::num_size_classes;
+
+template <bool TShared, typename... TSizeClasses>
+const std::size_t PoolAllocatorSet<TShared, TSizeClasses...>::max_size;
+
+} // namespace weos_detail
+
+//! A set of memory pools for different size classes.
+//! The pool_allocator_set holds a memory_pool for each of the given size
+//! classes, which have to be sorted by increasing size. An allocation is
+//! routed to the smallest size class which fits by means of a lookup table,
+//! which is generated at compile-time.
+//!
+//! Example:
+//! \code
+//! weos::pool_allocator_set<weos::size_class<16, 32>,
+//!                          weos::size_class<64, 8>,
+//!                          weos::size_class<256, 2>> allocators;
+//! void* p = allocators.allocate(20, 4); // allocates from the 64-byte class
+//! allocators.deallocate(p, 20);
+//! \endcode
+//!
+//! The pool_allocator_set is not thread-safe. The shared_pool_allocator_set
+//! is an alternative if thread-safety is needed.
+template <typename... TSizeClasses>
+using pool_allocator_set = weos_detail::PoolAllocatorSet<false, TSizeClasses...>;
+
+//! A thread-safe set of memory pools for different size classes.
+//! The shared_pool_allocator_set is a thread-safe alternative to the
+//! pool_allocator_set. It holds a shared_memory_pool per size class.
+template <typename... TSizeClasses>
+using shared_pool_allocator_set = weos_detail::PoolAllocatorSet<true, TSizeClasses...>;
+
+//! An allocator which is backed by a pool allocator set.
+//! The pool_allocator satisfies the allocator requirements of the standard
+//! library and can be used to allocate the elements of containers from
+//! a pool_allocator_set or a shared_pool_allocator_set. If the set is
+//! exhausted, a system_error is thrown.
+template <typename TType, typename TAllocatorSet>
+class pool_allocator
+{
+public:
+    typedef TType value_type;
+    typedef TType* pointer;
+    typedef const TType* const_pointer;
+    typedef TType& reference;
+    typedef const TType& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename TOther>
+    struct rebind
+    {
+        typedef pool_allocator<TOther, TAllocatorSet> other;
+    };
+
+    //! Creates an allocator which allocates from the given \p allocatorSet.
+    explicit
+    pool_allocator(TAllocatorSet& allocatorSet) noexcept
+        : m_allocatorSet(&allocatorSet)
+    {
+    }
+
+    template <typename TOther>
+    pool_allocator(const pool_allocator<TOther, TAllocatorSet>& other) noexcept
+        : m_allocatorSet(other.m_allocatorSet)
+    {
+    }
+
+    //! Allocates memory for \p n elements.
+    pointer allocate(size_type n)
+    {
+        void* chunk = m_allocatorSet->allocate(n * sizeof(value_type),
+                                               alignment_of<value_type>::value);
+        if (!chunk)
+            WEOS_THROW_SYSTEM_ERROR(std::errc::not_enough_memory,
+                                    "pool_allocator::allocate failed");
+        return static_cast<pointer>(chunk);
+    }
+
+    //! Frees the memory of \p n elements at \p p.
+    void deallocate(pointer p, size_type n) noexcept
+    {
+        m_allocatorSet->deallocate(p, n * sizeof(value_type));
+    }
+
+private:
+    TAllocatorSet* m_allocatorSet;
+
+    template <typename TOther, typename TOtherSet>
+    friend class pool_allocator;
+
+    template <typename T1, typename T2, typename TSet>
+    friend bool operator==(const pool_allocator<T1, TSet>&,
+                           const pool_allocator<T2, TSet>&) noexcept;
+};
+
+template <typename T1, typename T2, typename TAllocatorSet>
+inline
+bool operator==(const pool_allocator<T1, TAllocatorSet>& a,
+                const pool_allocator<T2, TAllocatorSet>& b) noexcept
+{
+    return a.m_allocatorSet == b.m_allocatorSet;
+}
+
+template <typename T1, typename T2, typename TAllocatorSet>
+inline
+bool operator!=(const pool_allocator<T1, TAllocatorSet>& a,
+                const pool_allocator<T2, TAllocatorSet>& b) noexcept
+{
+    return !(a == b);
+}
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_POOLALLOCATOR_HPP
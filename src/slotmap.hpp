@@ -0,0 +1,415 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_SLOTMAP_HPP
+#define WEOS_SLOTMAP_HPP
+
+#include "_config.hpp"
+
+#include "type_traits.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+//! A container with generational handles.
+//! A slot_map stores up to (\p TNumElem) values of type \p TElement. The
+//! memory is allocated statically (internally in the object), i.e. the
+//! container does not allocate memory from the heap.
+//!
+//! The values are stored densely in a contiguous array. Iterating over them
+//! is a linear scan. When a value is erased, the last value is moved into
+//! the gap. Therefore, the addresses of the values are not stable. Instead,
+//! an insertion returns a 32-bit handle, which remains valid until the
+//! value is erased. The handle refers to a slot, which stores the current
+//! position of the value in the dense array, and contains the generation of
+//! that slot. The generation is incremented whenever the slot is freed or
+//! re-used. Thus, a stale handle is detected reliably until the generation
+//! counter wraps around.
+//!
+//! Insertion, erasure and lookup run in constant time.
+//!
+//! The slot_map is not thread-safe.
+template <typename TElement, std::size_t TNumElem>
+class slot_map
+{
+    static_assert(TNumElem > 0, "The number of elements must be non-zero.");
+    static_assert(TNumElem < (std::size_t(1) << 24),
+                  "The number of elements must be less than 2^24.");
+
+    //! Returns the number of bits which are needed to store the index of
+    //! one of \p n slots.
+    static constexpr unsigned index_bits_for(std::size_t n, unsigned bits = 1)
+    {
+        return (std::size_t(1) << bits) >= n ? bits : index_bits_for(n, bits + 1);
+    }
+
+    // The lower bits of a handle hold the slot index, the upper bits hold
+    // the generation.
+    static const unsigned index_bits = index_bits_for(TNumElem);
+    static const std::uint32_t index_mask = (std::uint32_t(1) << index_bits) - 1;
+    static const std::uint32_t generation_mask = ~std::uint32_t(0) >> index_bits;
+
+    // Marks the end of the list of free slots.
+    static const std::uint32_t null_slot = ~std::uint32_t(0);
+
+    // A slot. The generation is odd while the slot refers to a value and
+    // even while the slot is free.
+    struct Slot
+    {
+        //! The position of the value in the dense array, if the slot is in
+        //! use, or the next free slot, otherwise.
+        std::uint32_t index;
+        //! The generation of the slot.
+        std::uint32_t generation;
+    };
+
+    typedef typename aligned_storage<sizeof(TElement),
+                                     alignment_of<TElement>::value>::type storage_type;
+
+public:
+    //! The type of the values.
+    typedef TElement value_type;
+    typedef std::size_t size_type;
+    typedef value_type& reference;
+    typedef const value_type& const_reference;
+    typedef value_type* iterator;
+    typedef const value_type* const_iterator;
+
+    //! A handle to a value in a slot_map.
+    //! A default-constructed handle does not refer to any value.
+    class handle_type
+    {
+    public:
+        constexpr handle_type() noexcept
+            : m_value(0)
+        {
+        }
+
+        //! Creates a handle from its integral representation \p value.
+        constexpr explicit handle_type(std::uint32_t value) noexcept
+            : m_value(value)
+        {
+        }
+
+        //! Returns the integral representation of the handle.
+        constexpr std::uint32_t value() const noexcept
+        {
+            return m_value;
+        }
+
+        friend
+        constexpr bool operator==(handle_type lhs, handle_type rhs) noexcept
+        {
+            return lhs.m_value == rhs.m_value;
+        }
+
+        friend
+        constexpr bool operator!=(handle_type lhs, handle_type rhs) noexcept
+        {
+            return lhs.m_value != rhs.m_value;
+        }
+
+    private:
+        std::uint32_t m_value;
+    };
+
+    //! Creates an empty slot_map.
+    constexpr slot_map() noexcept
+        : m_values{},
+          m_denseToSlot{},
+          m_slots{},
+          m_size(0),
+          m_numTouchedSlots(0),
+          m_freeSlot(null_slot)
+    {
+    }
+
+    slot_map(const slot_map&) = delete;
+    slot_map& operator=(const slot_map&) = delete;
+
+    //! Destroys the slot_map and all values in it.
+    ~slot_map()
+    {
+        for (size_type idx = 0; idx < m_size; ++idx)
+            value(idx)->~value_type();
+    }
+
+    //! Returns the maximum number of values.
+    size_type capacity() const noexcept
+    {
+        return TNumElem;
+    }
+
+    //! Returns the number of values.
+    size_type size() const noexcept
+    {
+        return m_size;
+    }
+
+    //! Checks if the container is empty.
+    //! Returns \p true, if the container does not hold any value.
+    bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    //! Checks if the container is full.
+    //! Returns \p true, if no more value can be inserted.
+    bool full() const noexcept
+    {
+        return m_size == TNumElem;
+    }
+
+    //! Constructs a value in-place.
+    //! Constructs a new value from the given \p args and returns a handle to
+    //! it. If the container is full, an invalid (default-constructed) handle
+    //! is returned.
+    template <typename... TArgs>
+    handle_type try_emplace(TArgs&&... args)
+    {
+        if (full())
+            return handle_type();
+
+        new (value(m_size)) value_type(std::forward<TArgs>(args)...);
+
+        std::uint32_t slotIndex;
+        if (m_freeSlot != null_slot)
+        {
+            slotIndex = m_freeSlot;
+            m_freeSlot = m_slots[slotIndex].index;
+        }
+        else
+        {
+            slotIndex = std::uint32_t(m_numTouchedSlots++);
+        }
+
+        Slot& slot = m_slots[slotIndex];
+        slot.index = std::uint32_t(m_size);
+        slot.generation = (slot.generation + 1) & generation_mask;
+        m_denseToSlot[m_size] = slotIndex;
+        ++m_size;
+        return make_handle(slotIndex, slot.generation);
+    }
+
+    //! Inserts a value.
+    //! Copies the \p value into the container and returns a handle to it.
+    //! If the container is full, an invalid handle is returned.
+    handle_type try_insert(const value_type& value)
+    {
+        return try_emplace(value);
+    }
+
+    //! Inserts a value.
+    //! Moves the \p value into the container and returns a handle to it.
+    //! If the container is full, an invalid handle is returned.
+    handle_type try_insert(value_type&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    //! Erases a value.
+    //! Destroys the value referenced by the handle \p h. The last value in
+    //! the dense array is moved into its place. Returns \p true, if a value
+    //! has been erased, and \p false, if the handle is stale.
+    bool erase(handle_type h)
+    {
+        Slot* slot = find_slot(h);
+        if (!slot)
+            return false;
+
+        erase_at(slot->index);
+        return true;
+    }
+
+    //! Erases a value.
+    //! Erases the value pointed to by \p iter. The last value is moved into
+    //! its place, i.e. \p iter points to the next value to visit afterwards.
+    //! This allows to erase values while iterating:
+    //! \code
+    //! for (auto iter = map.begin(); iter != map.end();)
+    //!     if (shall_erase(*iter))
+    //!         iter = map.erase(iter);
+    //!     else
+    //!         ++iter;
+    //! \endcode
+    iterator erase(const_iterator iter)
+    {
+        size_type denseIndex = iter - begin();
+        WEOS_ASSERT(denseIndex < m_size);
+        erase_at(denseIndex);
+        return begin() + denseIndex;
+    }
+
+    //! Erases all values.
+    //! Destroys all values and invalidates all handles.
+    void clear() noexcept
+    {
+        while (m_size)
+            erase_at(m_size - 1);
+    }
+
+    //! Checks if a handle is valid.
+    //! Returns \p true, if the handle \p h refers to a value.
+    bool contains(handle_type h) const noexcept
+    {
+        return find_slot(h) != 0;
+    }
+
+    //! Looks up a value.
+    //! Returns a pointer to the value referenced by the handle \p h or a
+    //! null-pointer, if the handle is stale. The pointer is invalidated by
+    //! the next insertion or erasure.
+    value_type* find(handle_type h) noexcept
+    {
+        const Slot* slot = find_slot(h);
+        return slot ? value(slot->index) : 0;
+    }
+
+    //! Looks up a value.
+    //! Returns a pointer to the value referenced by the handle \p h or a
+    //! null-pointer, if the handle is stale.
+    const value_type* find(handle_type h) const noexcept
+    {
+        const Slot* slot = find_slot(h);
+        return slot ? value(slot->index) : 0;
+    }
+
+    //! Returns the handle of the value pointed to by \p iter.
+    handle_type get_handle(const_iterator iter) const noexcept
+    {
+        size_type denseIndex = iter - begin();
+        WEOS_ASSERT(denseIndex < m_size);
+        std::uint32_t slotIndex = m_denseToSlot[denseIndex];
+        return make_handle(slotIndex, m_slots[slotIndex].generation);
+    }
+
+    //! Returns an iterator to the first value.
+    iterator begin() noexcept
+    {
+        return value(0);
+    }
+
+    //! Returns an iterator to the first value.
+    const_iterator begin() const noexcept
+    {
+        return value(0);
+    }
+
+    //! Returns an iterator past the last value.
+    iterator end() noexcept
+    {
+        return value(m_size);
+    }
+
+    //! Returns an iterator past the last value.
+    const_iterator end() const noexcept
+    {
+        return value(m_size);
+    }
+
+private:
+    //! The densely packed values.
+    storage_type m_values[TNumElem];
+    //! Maps the position of a value in the dense array to its slot.
+    std::uint32_t m_denseToSlot[TNumElem];
+    //! The slots.
+    Slot m_slots[TNumElem];
+    //! The number of values.
+    size_type m_size;
+    //! The number of slots which have been used at least once.
+    size_type m_numTouchedSlots;
+    //! The first slot in the list of free slots.
+    std::uint32_t m_freeSlot;
+
+    value_type* value(size_type denseIndex) noexcept
+    {
+        return reinterpret_cast<value_type*>(&m_values[denseIndex]);
+    }
+
+    const value_type* value(size_type denseIndex) const noexcept
+    {
+        return reinterpret_cast<const value_type*>(&m_values[denseIndex]);
+    }
+
+    static handle_type make_handle(std::uint32_t slotIndex,
+                                   std::uint32_t generation) noexcept
+    {
+        return handle_type((generation << index_bits) | slotIndex);
+    }
+
+    //! Returns the slot referenced by the handle \p h or a null-pointer, if
+    //! the handle is stale.
+    const Slot* find_slot(handle_type h) const noexcept
+    {
+        std::uint32_t slotIndex = h.value() & index_mask;
+        std::uint32_t generation = h.value() >> index_bits;
+        if (slotIndex >= m_numTouchedSlots || (generation & 1) == 0
+            || m_slots[slotIndex].generation != generation)
+        {
+            return 0;
+        }
+        return &m_slots[slotIndex];
+    }
+
+    Slot* find_slot(handle_type h) noexcept
+    {
+        return const_cast<Slot*>(static_cast<const slot_map*>(this)->find_slot(h));
+    }
+
+    //! Erases the value at position \p denseIndex by moving the last value
+    //! into its place.
+    void erase_at(size_type denseIndex)
+    {
+        std::uint32_t slotIndex = m_denseToSlot[denseIndex];
+        size_type last = m_size - 1;
+
+        value(denseIndex)->~value_type();
+        if (denseIndex != last)
+        {
+            new (value(denseIndex)) value_type(std::move(*value(last)));
+            value(last)->~value_type();
+            m_denseToSlot[denseIndex] = m_denseToSlot[last];
+            m_slots[m_denseToSlot[denseIndex]].index = std::uint32_t(denseIndex);
+        }
+        --m_size;
+
+        Slot& slot = m_slots[slotIndex];
+        slot.generation = (slot.generation + 1) & generation_mask;
+        slot.index = m_freeSlot;
+        m_freeSlot = slotIndex;
+    }
+};
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_SLOTMAP_HPP
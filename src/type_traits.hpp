@@ -105,6 +105,7 @@ using std::is_literal_type;
 using std::is_nothrow_constructible;
 using std::is_nothrow_copy_constructible;
 using std::is_nothrow_default_constructible;
+using std::is_nothrow_move_constructible;
 using std::is_union;
 using std::is_trivially_copyable;
 
@@ -0,0 +1,307 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_WAITANY_HPP
+#define WEOS_WAITANY_HPP
+
+#include "_config.hpp"
+
+#include "chrono.hpp"
+#include "messagequeue.hpp"
+#include "semaphore.hpp"
+#include "thread.hpp"
+#include "type_traits.hpp"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+
+WEOS_BEGIN_NAMESPACE
+
+namespace weos_detail
+{
+
+// The sources of wait_any() provide two functions, which are found by
+// argument-dependent lookup. select_ready() checks if the source is ready
+// and select_queue() returns the wait queue, which is notified when the
+// source might have become ready.
+
+inline
+bool select_ready(thread::signal_set mask)
+{
+    return (current_signals() & mask) != 0;
+}
+
+inline
+_tq& select_queue(thread::signal_set)
+{
+    return current_signal_selectors();
+}
+
+//! A type-erased source of wait_any().
+class WaitAnySource
+{
+public:
+    template <typename TSource>
+    explicit
+    WaitAnySource(TSource& source)
+        : m_source(&source),
+          m_queue(&select_queue(source)),
+          m_ready(&isReady<TSource>)
+    {
+    }
+
+    bool ready() const
+    {
+        return m_ready(m_source);
+    }
+
+    _tq& queue() const noexcept
+    {
+        return *m_queue;
+    }
+
+private:
+    const void* m_source;
+    _tq* m_queue;
+    bool (*m_ready)(const void*);
+
+    template <typename TSource>
+    static bool isReady(const void* source)
+    {
+        return select_ready(*static_cast<const TSource*>(source));
+    }
+};
+
+//! Returns the index of the first ready source or -1, if no source is ready.
+template <std::size_t TNumSources>
+int findReadySource(const WaitAnySource (&sources)[TNumSources])
+{
+    for (std::size_t idx = 0; idx < TNumSources; ++idx)
+        if (sources[idx].ready())
+            return int(idx);
+    return -1;
+}
+
+//! The links of a waiting thread into the wait queues of all sources. The
+//! first link is the waiter. The notifications of the other links are
+//! forwarded to it. Thus, the thread blocks on a single object.
+template <std::size_t TNumSources>
+class WaitAnyLinks
+{
+public:
+    explicit
+    WaitAnyLinks(const WaitAnySource (&sources)[TNumSources])
+        : m_numLinks(0)
+    {
+        new (&m_links[0]) _tq::_t(sources[0].queue());
+        m_numLinks = 1;
+        try
+        {
+            for (; m_numLinks < TNumSources; ++m_numLinks)
+            {
+                new (&m_links[m_numLinks]) _tq::_t(sources[m_numLinks].queue(),
+                                                   waiter());
+            }
+        }
+        catch (...)
+        {
+            unlink(nullptr);
+            throw;
+        }
+    }
+
+    ~WaitAnyLinks()
+    {
+        unlink(nullptr);
+    }
+
+    WaitAnyLinks(const WaitAnyLinks&) = delete;
+    WaitAnyLinks& operator=(const WaitAnyLinks&) = delete;
+
+    _tq::_t& waiter() noexcept
+    {
+        return link(0);
+    }
+
+    //! Removes all links from their queues. The waiter is removed last
+    //! because the other links refer to it. If \p notified is not null,
+    //! it is set to \p true for every link, which has been notified.
+    void unlink(bool* notified) noexcept
+    {
+        while (m_numLinks)
+        {
+            --m_numLinks;
+            bool wasNotified = link(m_numLinks).unlink();
+            if (notified)
+                notified[m_numLinks] = wasNotified;
+            link(m_numLinks).~_t();
+        }
+    }
+
+private:
+    typename aligned_storage<sizeof(_tq::_t),
+                             alignment_of<_tq::_t>::value>::type m_links[TNumSources];
+    std::size_t m_numLinks;
+
+    _tq::_t& link(std::size_t idx) noexcept
+    {
+        return *static_cast<_tq::_t*>(static_cast<void*>(&m_links[idx]));
+    }
+};
+
+//! Waits until one of the \p sources is ready. \p wait blocks on the waiter
+//! and returns \p false upon a timeout.
+template <std::size_t TNumSources, typename TWait>
+int waitAny(const WaitAnySource (&sources)[TNumSources], TWait wait)
+{
+    int index = findReadySource(sources);
+    if (index >= 0)
+        return index;
+
+    for (;;)
+    {
+        bool notified[TNumSources];
+        bool timedOut = false;
+        {
+            // Link into all queues before re-checking the sources. Then a
+            // source which becomes ready in between cannot be missed.
+            WaitAnyLinks<TNumSources> links(sources);
+            index = findReadySource(sources);
+            if (index < 0)
+                timedOut = !wait(links.waiter());
+            links.unlink(notified);
+        }
+
+        if (index < 0)
+            index = findReadySource(sources);
+
+        // A notification, which has been sent to this thread, might have been
+        // meant for another waiter of the same source. It is passed on for
+        // every source, which is not reported as ready.
+        for (std::size_t idx = 0; idx < TNumSources; ++idx)
+            if (notified[idx] && int(idx) != index)
+                sources[idx].queue().notify_one();
+
+        if (index >= 0 || timedOut)
+            return index;
+    }
+}
+
+} // namespace weos_detail
+
+//! \brief Waits until any of the given sources is ready.
+//!
+//! Blocks the calling thread until one of the \p sources is ready and
+//! returns its index in the argument list. If several sources are ready,
+//! the lowest index is returned. A source can be
+//! - a message queue (message_queue, spsc_message_queue,
+//!   priority_message_queue or mail_queue), which is ready when it holds an
+//!   element,
+//! - a semaphore, which is ready when its value is non-zero, or
+//! - a thread::signal_set, which is ready when any of these signal flags is
+//!   set for the calling thread. The signals must be set with
+//!   thread::set_signals().
+//!
+//! The method does not take anything from the source. Another thread might
+//! do so before the caller gets to it, which is why the caller should use
+//! the non-blocking try_ operations and call wait_any() again if they fail.
+//!
+//! \note The calling thread links itself into the wait queue of every
+//! source. No polling is involved.
+template <typename... TSources>
+int wait_any(TSources&&... sources)
+{
+    static_assert(sizeof...(TSources) > 0, "At least one source is required.");
+
+    const weos_detail::WaitAnySource wrapped[] = {
+        weos_detail::WaitAnySource(sources)...
+    };
+    return weos_detail::waitAny(wrapped, [](weos_detail::_tq::_t& waiter) {
+        waiter.wait();
+        return true;
+    });
+}
+
+//! \brief Checks if any of the given sources is ready.
+//!
+//! Returns the index of the first of the \p sources, which is ready, or -1,
+//! if none of them is ready. The calling thread is never blocked.
+//!
+//! \sa wait_any()
+template <typename... TSources>
+int try_wait_any(TSources&&... sources)
+{
+    static_assert(sizeof...(TSources) > 0, "At least one source is required.");
+
+    const weos_detail::WaitAnySource wrapped[] = {
+        weos_detail::WaitAnySource(sources)...
+    };
+    return weos_detail::findReadySource(wrapped);
+}
+
+//! \brief Waits until any of the given sources is ready or a timeout occurs.
+//!
+//! Blocks the calling thread until either one of the \p sources is ready or
+//! the timeout duration \p d expires. Returns the index of the ready source
+//! or -1 in case of a timeout.
+//!
+//! \sa wait_any()
+template <typename TRep, typename TPeriod, typename... TSources>
+int try_wait_any_for(const chrono::duration<TRep, TPeriod>& d,
+                     TSources&&... sources)
+{
+    return try_wait_any_until(chrono::steady_clock::now() + d,
+                              std::forward<TSources>(sources)...);
+}
+
+//! \brief Waits until any of the given sources is ready or a timeout occurs.
+//!
+//! Blocks the calling thread until either one of the \p sources is ready or
+//! the point in time \p time has been reached. Returns the index of the
+//! ready source or -1 in case of a timeout.
+//!
+//! \sa wait_any()
+template <typename TClock, typename TDuration, typename... TSources>
+int try_wait_any_until(const chrono::time_point<TClock, TDuration>& time,
+                       TSources&&... sources)
+{
+    static_assert(sizeof...(TSources) > 0, "At least one source is required.");
+
+    const weos_detail::WaitAnySource wrapped[] = {
+        weos_detail::WaitAnySource(sources)...
+    };
+    return weos_detail::waitAny(wrapped, [&](weos_detail::_tq::_t& waiter) {
+        return waiter.wait_until(time);
+    });
+}
+
+WEOS_END_NAMESPACE
+
+#endif // WEOS_WAITANY_HPP
@@ -155,6 +155,36 @@ static constexpr unsigned WEOS_SYSTICK_FREQUENCY = 1000;
 // approximately track the stack usage.
 // #define WEOS_ENABLE_STACK_WATERMARKING
 
+// -----------------------------------------------------------------------------
+//     Memory pools
+// -----------------------------------------------------------------------------
+
+// Set this macro to record allocation statistics in the memory pools. The
+// statistics can be queried with statistics(). When the macro is not set, the
+// pools do not record any statistics and their size does not change.
+// #define WEOS_ENABLE_POOL_STATISTICS
+
+// The size of a cache line in bytes. It is used by the cacheline_aligned
+// chunk layout of the memory pools and to separate the producer and consumer
+// sides of the lock-free message queues. If the macro is not set, a size of
+// 64 bytes is assumed. In CMSIS-RTOS, the default is the alignment of a
+// pointer instead, because the Cortex-M cores have no data cache.
+// #define WEOS_CACHE_LINE_SIZE 64
+
+// -----------------------------------------------------------------------------
+//     Message queues
+// -----------------------------------------------------------------------------
+
+// Set this macro to record occupancy and latency statistics in the message
+// queues. Every message_queue tracks its current size, the high-water mark,
+// the number of sends which found the queue full and a histogram of the
+// time the elements spend in the queue. The statistics can be queried with
+// statistics(). When the macro is not set, nothing is recorded and the size
+// of the queues does not change.
+// Note: In CMSIS-RTOS, message queues for small types do not use the OS'
+// message queue if the statistics are enabled.
+// #define WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
 // -----------------------------------------------------------------------------
 //     Misc
 // -----------------------------------------------------------------------------
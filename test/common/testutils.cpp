@@ -28,6 +28,13 @@
 
 #include "testutils.hpp"
 
+#if defined(__linux__)
+// The start and the end of the .bss section, which are provided by the
+// GNU linker.
+extern "C" char __bss_start[];
+extern "C" char _end[];
+#endif // __linux__
+
 namespace testing
 {
 
@@ -40,4 +47,15 @@ std::uint32_t random()
     return x - 1;
 }
 
+bool is_in_bss(const void* address)
+{
+#if defined(__linux__)
+    const char* p = static_cast<const char*>(address);
+    return p >= __bss_start && p < _end;
+#else
+    (void)address;
+    return true;
+#endif // __linux__
+}
+
 } // namespace testing
@@ -37,6 +37,12 @@ namespace testing
 // Produces a pseudo-random number the range [0, 2147483645].
 std::uint32_t random();
 
+// Checks if the object at the given address has been placed in the .bss
+// section, i.e. its initial value is all zero bits and it does not need any
+// data in the image. The check uses the symbols of the GNU linker and is
+// only performed on Linux. On other targets, true is returned.
+bool is_in_bss(const void* address);
+
 } // namespace testing
 
 #endif // TESTUTILS_HPP
@@ -0,0 +1,106 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+// Measures the allocation throughput of the shared_memory_pool and the
+// magazine_memory_pool for an increasing number of threads. Every thread
+// repeatedly allocates a burst of chunks and frees them again.
+
+#include <chrono.hpp>
+#include <memorypool.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <new>
+
+namespace
+{
+
+const unsigned NUM_ITERATIONS = 200000;
+const unsigned BURST_SIZE = 4;
+const unsigned MAX_NUM_THREADS = 8;
+
+template <typename TPool>
+void allocation_loop(TPool* pool)
+{
+    void* chunks[BURST_SIZE];
+    for (unsigned i = 0; i < NUM_ITERATIONS; ++i)
+    {
+        unsigned numAllocated = 0;
+        for (; numAllocated < BURST_SIZE; ++numAllocated)
+        {
+            chunks[numAllocated] = pool->try_allocate();
+            if (chunks[numAllocated] == 0)
+                break;
+        }
+        for (unsigned j = 0; j < numAllocated; ++j)
+            pool->free(chunks[j]);
+    }
+}
+
+// Returns the number of allocations per microsecond.
+template <typename TPool>
+double measure(unsigned numThreads)
+{
+    using namespace weos::chrono;
+
+    // The pools have an extended alignment, which a plain new-expression
+    // does not honour in C++11. So they are placed in aligned storage.
+    static typename weos::aligned_storage<
+            sizeof(TPool), weos::alignment_of<TPool>::value>::type storage;
+    TPool* pool = new (&storage) TPool;
+    weos::thread threads[MAX_NUM_THREADS];
+
+    steady_clock::time_point start = steady_clock::now();
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i] = weos::thread(allocation_loop<TPool>, pool);
+    for (unsigned i = 0; i < numThreads; ++i)
+        threads[i].join();
+    steady_clock::duration elapsed = steady_clock::now() - start;
+
+    pool->~TPool();
+    return double(numThreads) * NUM_ITERATIONS * BURST_SIZE
+           / duration_cast<microseconds>(elapsed).count();
+}
+
+} // anonymous namespace
+
+TEST(magazine_memory_pool, throughput)
+{
+    typedef weos::shared_memory_pool<double, 256> shared_pool_t;
+    typedef weos::magazine_memory_pool<double, 256> magazine_pool_t;
+
+    std::printf("threads  shared_memory_pool  magazine_memory_pool  [alloc/us]\n");
+    for (unsigned numThreads = 1; numThreads <= MAX_NUM_THREADS; numThreads *= 2)
+    {
+        double shared = measure<shared_pool_t>(numThreads);
+        double magazine = measure<magazine_pool_t>(numThreads);
+        std::printf("%7u  %18.1f  %20.1f\n", numThreads, shared, magazine);
+    }
+}
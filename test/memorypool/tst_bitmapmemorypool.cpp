@@ -0,0 +1,166 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <memorypool.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <set>
+#include <vector>
+
+template <typename T>
+class BitmapMemoryPoolTestFixture : public testing::Test
+{
+};
+
+// Define a list of types with which the memory pool will be instantiated.
+typedef testing::Types<
+    std::int8_t,  std::int16_t,  std::int32_t,  std::int64_t,
+    float, double, long double> TypesToTest;
+TYPED_TEST_CASE(BitmapMemoryPoolTestFixture, TypesToTest);
+
+TYPED_TEST(BitmapMemoryPoolTestFixture, Constructor)
+{
+    weos::bitmap_memory_pool<TypeParam, 1> p1;
+    ASSERT_FALSE(p1.empty());
+    ASSERT_EQ(1, p1.capacity());
+
+    weos::bitmap_memory_pool<TypeParam, 70> p70;
+    ASSERT_FALSE(p70.empty());
+    ASSERT_EQ(70, p70.capacity());
+}
+
+TYPED_TEST(BitmapMemoryPoolTestFixture, try_allocate)
+{
+    const unsigned POOL_SIZE = 70;
+    weos::bitmap_memory_pool<TypeParam, POOL_SIZE> p;
+    char* chunks[POOL_SIZE];
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        ASSERT_FALSE(p.empty());
+        void* c = p.try_allocate();
+        ASSERT_TRUE(c != 0);
+        ASSERT_TRUE(p.is_allocated(c));
+
+        char* addr = static_cast<char*>(c);
+        ASSERT_TRUE(reinterpret_cast<uintptr_t>(addr)
+                    % weos::alignment_of<TypeParam>::value == 0);
+
+        // Chunks are allocated in the order of increasing addresses.
+        if (i > 0)
+        {
+            ASSERT_TRUE(chunks[i - 1] + sizeof(TypeParam) <= addr);
+        }
+        chunks[i] = addr;
+    }
+
+    ASSERT_TRUE(p.empty());
+    ASSERT_TRUE(p.try_allocate() == 0);
+
+    // The chunk with the lowest address is reused first.
+    p.free(chunks[40]);
+    p.free(chunks[3]);
+    ASSERT_FALSE(p.is_allocated(chunks[3]));
+    ASSERT_TRUE(p.try_allocate() == chunks[3]);
+    ASSERT_TRUE(p.try_allocate() == chunks[40]);
+    ASSERT_TRUE(p.empty());
+}
+
+TYPED_TEST(BitmapMemoryPoolTestFixture, for_each_allocated)
+{
+    const unsigned POOL_SIZE = 70;
+    weos::bitmap_memory_pool<TypeParam, POOL_SIZE> p;
+    void* chunks[POOL_SIZE];
+
+    std::vector<void*> visited;
+    p.for_each_allocated([&](void* c) { visited.push_back(c); });
+    ASSERT_TRUE(visited.empty());
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        chunks[i] = p.try_allocate();
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        if (i % 3 != 0)
+            p.free(chunks[i]);
+
+    p.for_each_allocated([&](void* c) { visited.push_back(c); });
+    ASSERT_EQ((POOL_SIZE + 2) / 3, visited.size());
+    for (unsigned i = 0; i < visited.size(); ++i)
+        ASSERT_TRUE(visited[i] == chunks[3 * i]);
+
+    // Free all chunks during the iteration.
+    p.for_each_allocated([&](void* c) { p.free(c); });
+    visited.clear();
+    p.for_each_allocated([&](void* c) { visited.push_back(c); });
+    ASSERT_TRUE(visited.empty());
+}
+
+TYPED_TEST(BitmapMemoryPoolTestFixture, random_allocate_and_free)
+{
+    const unsigned POOL_SIZE = 40;
+    weos::bitmap_memory_pool<TypeParam, POOL_SIZE> p;
+    void* chunks[POOL_SIZE];
+    std::set<void*> uniqueChunks;
+    unsigned numAllocatedChunks = 0;
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        chunks[i] = p.try_allocate();
+        uniqueChunks.insert(chunks[i]);
+    }
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        p.free(chunks[i]);
+        chunks[i] = 0;
+    }
+    ASSERT_EQ(POOL_SIZE, uniqueChunks.size());
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        unsigned index = testing::random() % POOL_SIZE;
+        if (chunks[index] == 0)
+        {
+            void* c = p.try_allocate();
+            ASSERT_TRUE(c != 0);
+            ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
+            chunks[index] = c;
+            ++numAllocatedChunks;
+        }
+        else
+        {
+            p.free(chunks[index]);
+            chunks[index] = 0;
+            --numAllocatedChunks;
+        }
+
+        unsigned numVisited = 0;
+        p.for_each_allocated([&](void*) { ++numVisited; });
+        ASSERT_EQ(numAllocatedChunks, numVisited);
+    }
+}
@@ -0,0 +1,161 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <memorypool.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <set>
+
+namespace
+{
+// Storage for the pools with a known alignment.
+union Storage
+{
+    char data[256];
+    std::max_align_t align;
+};
+} // anonymous namespace
+
+TEST(dynamic_memory_pool, Constructor)
+{
+    Storage storage;
+
+    {
+        weos::dynamic_memory_pool p(storage.data, sizeof(storage.data), 16, 8);
+        ASSERT_FALSE(p.empty());
+        ASSERT_EQ(16, p.chunk_size());
+        ASSERT_EQ(16, p.capacity());
+    }
+
+    {
+        // The chunk size is rounded up to the alignment.
+        weos::dynamic_memory_pool p(storage.data, sizeof(storage.data), 20, 16);
+        ASSERT_EQ(32, p.chunk_size());
+        ASSERT_EQ(8, p.capacity());
+    }
+
+    {
+        // A chunk must be able to hold a pointer.
+        weos::dynamic_memory_pool p(storage.data, sizeof(storage.data), 1, 1);
+        ASSERT_EQ(sizeof(void*), p.chunk_size());
+        ASSERT_EQ(256 / sizeof(void*), p.capacity());
+    }
+
+    {
+        // The padding for the alignment is subtracted from the memory.
+        weos::dynamic_memory_pool p(storage.data + 1, sizeof(storage.data) - 1,
+                                    16, 16);
+        ASSERT_EQ(15, p.capacity());
+    }
+
+    {
+        weos::dynamic_memory_pool p(storage.data, 8, 16, 16);
+        ASSERT_TRUE(p.empty());
+        ASSERT_EQ(0, p.capacity());
+        ASSERT_TRUE(p.try_allocate() == 0);
+    }
+}
+
+TEST(dynamic_memory_pool, try_allocate)
+{
+    Storage storage;
+    weos::dynamic_memory_pool p(storage.data + 3, sizeof(storage.data) - 3,
+                                24, 8);
+    const std::size_t POOL_SIZE = p.capacity();
+    ASSERT_EQ(10, POOL_SIZE);
+    char* chunks[10];
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        ASSERT_FALSE(p.empty());
+        void* c = p.try_allocate();
+        ASSERT_TRUE(c != 0);
+
+        char* addr = static_cast<char*>(c);
+        ASSERT_TRUE(reinterpret_cast<uintptr_t>(addr) % 8 == 0);
+        ASSERT_TRUE(addr >= storage.data + 3);
+        ASSERT_TRUE(addr + 24 <= storage.data + sizeof(storage.data));
+
+        for (unsigned j = 0; j < i; ++j)
+        {
+            // Chunks must not overlap.
+            if (chunks[j] < addr)
+            {
+                ASSERT_TRUE(chunks[j] + 24 <= addr);
+            }
+            if (chunks[j] > addr)
+            {
+                ASSERT_TRUE(addr + 24 <= chunks[j]);
+            }
+        }
+        chunks[i] = addr;
+    }
+
+    ASSERT_TRUE(p.empty());
+    ASSERT_TRUE(p.try_allocate() == 0);
+}
+
+TEST(dynamic_memory_pool, random_allocate_and_free)
+{
+    Storage storage;
+    weos::dynamic_memory_pool p(storage.data, sizeof(storage.data), 32, 16);
+    const unsigned POOL_SIZE = 8;
+    ASSERT_EQ(POOL_SIZE, p.capacity());
+    void* chunks[POOL_SIZE];
+    std::set<void*> uniqueChunks;
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        chunks[i] = p.try_allocate();
+        ASSERT_TRUE(chunks[i] != 0);
+        uniqueChunks.insert(chunks[i]);
+    }
+    ASSERT_TRUE(p.empty());
+    p.free_n(chunks, POOL_SIZE);
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        chunks[i] = 0;
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        unsigned index = testing::random() % POOL_SIZE;
+        if (chunks[index] == 0)
+        {
+            void* c = p.try_allocate();
+            ASSERT_TRUE(c != 0);
+            ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
+            chunks[index] = c;
+        }
+        else
+        {
+            p.free(chunks[index]);
+            chunks[index] = 0;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <memorypool.hpp>
+#include <thread.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <set>
+
+TEST(magazine_memory_pool, Constructor)
+{
+    weos::magazine_memory_pool<double, 10> p;
+    ASSERT_FALSE(p.empty());
+    ASSERT_EQ(10, p.capacity());
+}
+
+namespace
+{
+// The constructor is a constant expression and the pool does not point to
+// itself. Thus, this pool is placed in the .bss section.
+weos::magazine_memory_pool<double, 10> static_magazine_pool;
+} // anonymous namespace
+
+TEST(magazine_memory_pool, static_pool)
+{
+    ASSERT_TRUE(testing::is_in_bss(&static_magazine_pool));
+
+    void* chunk = static_magazine_pool.try_allocate();
+    ASSERT_TRUE(chunk != 0);
+    static_magazine_pool.free(chunk);
+    static_magazine_pool.flush();
+}
+
+TEST(magazine_memory_pool, try_allocate)
+{
+    const unsigned POOL_SIZE = 10;
+    weos::magazine_memory_pool<double, POOL_SIZE, 4> p;
+    std::set<void*> uniqueChunks;
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        ASSERT_FALSE(p.empty());
+        void* c = p.try_allocate();
+        ASSERT_TRUE(c != 0);
+        ASSERT_TRUE(reinterpret_cast<uintptr_t>(c)
+                    % weos::alignment_of<double>::value == 0);
+        uniqueChunks.insert(c);
+    }
+    ASSERT_EQ(POOL_SIZE, uniqueChunks.size());
+    ASSERT_TRUE(p.empty());
+    ASSERT_TRUE(p.try_allocate() == 0);
+}
+
+TEST(magazine_memory_pool, random_allocate_and_free)
+{
+    const unsigned POOL_SIZE = 10;
+    weos::magazine_memory_pool<double, POOL_SIZE, 4> p;
+    void* chunks[POOL_SIZE];
+    std::set<void*> uniqueChunks;
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        chunks[i] = p.try_allocate();
+        ASSERT_TRUE(chunks[i] != 0);
+        uniqueChunks.insert(chunks[i]);
+    }
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        p.free(chunks[i]);
+        chunks[i] = 0;
+    }
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        unsigned index = testing::random() % POOL_SIZE;
+        if (chunks[index] == 0)
+        {
+            void* c = p.try_allocate();
+            ASSERT_TRUE(c != 0);
+            ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
+            chunks[index] = c;
+        }
+        else
+        {
+            p.free(chunks[index]);
+            chunks[index] = 0;
+        }
+    }
+}
+
+namespace
+{
+
+typedef weos::magazine_memory_pool<std::uintptr_t, 64, 8> concurrency_test_pool_t;
+
+void concurrent_allocate_and_free(concurrency_test_pool_t* p,
+                                  std::uintptr_t id, bool* ok)
+{
+    const unsigned NUM_CHUNKS = 6;
+    std::uintptr_t* chunks[NUM_CHUNKS];
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        unsigned numAllocated = 0;
+        for (; numAllocated < NUM_CHUNKS; ++numAllocated)
+        {
+            void* c = p->try_allocate();
+            if (c == 0)
+                break;
+            chunks[numAllocated] = static_cast<std::uintptr_t*>(c);
+            *chunks[numAllocated] = id;
+        }
+
+        for (unsigned j = 0; j < numAllocated; ++j)
+        {
+            if (*chunks[j] != id)
+                *ok = false;
+            p->free(chunks[j]);
+        }
+    }
+    p->flush();
+}
+
+} // anonymous namespace
+
+TEST(magazine_memory_pool, concurrent_allocate_and_free)
+{
+    const unsigned NUM_THREADS = 4;
+    concurrency_test_pool_t p;
+    bool ok[NUM_THREADS];
+    weos::thread threads[NUM_THREADS];
+
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        ok[i] = true;
+        threads[i] = weos::thread(concurrent_allocate_and_free,
+                                  &p, std::uintptr_t(i + 1), &ok[i]);
+    }
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        threads[i].join();
+        ASSERT_TRUE(ok[i]);
+    }
+
+    // All threads have flushed their magazines.
+    for (unsigned i = 0; i < p.capacity(); ++i)
+        ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.empty());
+}
@@ -31,7 +31,9 @@
 #include "../common/testutils.hpp"
 #include "gtest/gtest.h"
 
+#include <algorithm>
 #include <set>
+#include <vector>
 
 template <typename T>
 class MemoryPoolTestFixture : public testing::Test
@@ -135,6 +137,35 @@ TYPED_TEST(MemoryPoolTestFixture, allocate_and_free)
     }
 }
 
+TYPED_TEST(MemoryPoolTestFixture, allocate_n_and_free_n)
+{
+    const unsigned POOL_SIZE = 10;
+    weos::memory_pool<TypeParam, POOL_SIZE> p;
+    void* chunks[POOL_SIZE + 1];
+    std::set<void*> uniqueChunks;
+
+    ASSERT_EQ(0, p.try_allocate_n(chunks, 0));
+    ASSERT_EQ(4, p.try_allocate_n(chunks, 4));
+    ASSERT_EQ(6, p.try_allocate_n(chunks + 4, 7));
+    ASSERT_TRUE(p.empty());
+    ASSERT_EQ(0, p.try_allocate_n(chunks, 1));
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        uniqueChunks.insert(chunks[i]);
+    ASSERT_EQ(POOL_SIZE, uniqueChunks.size());
+
+    p.free_n(chunks, 3);
+    ASSERT_FALSE(p.empty());
+    p.free_n(chunks + 3, POOL_SIZE - 3);
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        void* c = p.try_allocate();
+        ASSERT_TRUE(c != 0);
+        ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
+    }
+    ASSERT_TRUE(p.empty());
+}
+
 TYPED_TEST(MemoryPoolTestFixture, random_allocate_and_free)
 {
     const unsigned POOL_SIZE = 10;
@@ -230,3 +261,176 @@ TYPED_TEST(MemoryPoolTestFixture, allocate_inside_struct)
     ASSERT_TRUE(s.p.empty());
     ASSERT_EQ(POOL_SIZE, s.p.capacity());
 }
+
+namespace
+{
+// The constructor is a constant expression. Thus, this pool is
+// initialized statically.
+weos::memory_pool<std::int32_t, 1000> static_pool;
+weos::memory_pool<std::int32_t, 10, weos::handle_chunk_layout<> >
+    static_handle_pool;
+} // anonymous namespace
+
+TEST(memory_pool, static_pool)
+{
+    // The pool does not point to itself. Its initial value is all zero bits
+    // and so it is placed in the .bss section.
+    ASSERT_TRUE(testing::is_in_bss(&static_pool));
+    ASSERT_TRUE(testing::is_in_bss(&static_handle_pool));
+
+    ASSERT_FALSE(static_pool.empty());
+
+    // The chunks which have never been allocated are handed out in the
+    // order of increasing addresses.
+    char* c1 = static_cast<char*>(static_pool.try_allocate());
+    char* c2 = static_cast<char*>(static_pool.try_allocate());
+    ASSERT_TRUE(c1 != 0);
+    ASSERT_TRUE(c2 > c1);
+
+    // A freed chunk is recycled before an untouched one.
+    static_pool.free(c1);
+    ASSERT_TRUE(static_pool.try_allocate() == c1);
+
+    static_pool.free(c1);
+    static_pool.free(c2);
+}
+
+TEST(memory_pool, recycled_and_untouched_chunks)
+{
+    weos::memory_pool<std::int32_t, 4> p;
+    void* chunks[4];
+
+    ASSERT_EQ(2, p.try_allocate_n(chunks, 2));
+    p.free(chunks[0]);
+    // One recycled chunk and two untouched ones.
+    ASSERT_EQ(3, p.try_allocate_n(chunks + 1, 3));
+    ASSERT_TRUE(chunks[1] == chunks[0]);
+    ASSERT_TRUE(p.empty());
+    ASSERT_TRUE(p.try_allocate() == 0);
+
+    std::set<void*> unique(chunks + 1, chunks + 4);
+    ASSERT_EQ(3, unique.size());
+}
+
+TEST(memory_pool, cacheline_aligned)
+{
+    weos::memory_pool<std::int8_t, 4, weos::cacheline_aligned> p;
+    ASSERT_TRUE(sizeof(p) >= 4 * WEOS_CACHE_LINE_SIZE);
+
+    char* chunks[4];
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        chunks[i] = static_cast<char*>(p.try_allocate());
+        ASSERT_TRUE(chunks[i] != 0);
+        ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(chunks[i])
+                     % WEOS_CACHE_LINE_SIZE);
+        for (unsigned j = 0; j < i; ++j)
+        {
+            std::ptrdiff_t distance = chunks[i] - chunks[j];
+            ASSERT_TRUE(distance >= WEOS_CACHE_LINE_SIZE
+                        || -distance >= WEOS_CACHE_LINE_SIZE);
+        }
+    }
+    ASSERT_TRUE(p.empty());
+}
+
+TEST(memory_pool, aligned_chunk_layout)
+{
+    weos::memory_pool<std::int32_t, 3, weos::aligned_chunk_layout<32> > p;
+    char* c1 = static_cast<char*>(p.try_allocate());
+    char* c2 = static_cast<char*>(p.try_allocate());
+    ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(c1) % 32);
+    ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(c2) % 32);
+    ASSERT_EQ(32, c2 - c1);
+}
+
+TEST(memory_pool, for_each_allocated)
+{
+    const unsigned POOL_SIZE = 50;
+    weos::memory_pool<std::int32_t, POOL_SIZE> p;
+    void* chunks[POOL_SIZE] = {0};
+    std::set<void*> allocated;
+
+    for (unsigned i = 0; i < 2000; ++i)
+    {
+        unsigned index = random() % POOL_SIZE;
+        if (chunks[index] == 0)
+        {
+            chunks[index] = p.try_allocate();
+            ASSERT_TRUE(chunks[index] != 0);
+            allocated.insert(chunks[index]);
+        }
+        else
+        {
+            p.free(chunks[index]);
+            allocated.erase(chunks[index]);
+            chunks[index] = 0;
+        }
+
+        if (i % 100 == 0)
+        {
+            std::vector<void*> visited;
+            p.for_each_allocated([&](void* c) { visited.push_back(c); });
+            ASSERT_EQ(allocated.size(), visited.size());
+            ASSERT_TRUE(std::equal(visited.begin(), visited.end(),
+                                   allocated.begin()));
+        }
+    }
+
+    p.clear();
+    p.for_each_allocated([](void*) { FAIL(); });
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.empty());
+}
+
+TEST(memory_pool, handles)
+{
+    typedef weos::memory_pool<double, 10, weos::handle_chunk_layout<> > pool_type;
+    typedef pool_type::handle_type handle_type;
+    static_assert(sizeof(handle_type) == sizeof(std::uint32_t),
+                  "A handle must fit into 32 bits.");
+    static_assert(weos::is_trivially_copyable<handle_type>::value,
+                  "A handle must be trivially copyable.");
+    // Only a pool with handles stores the generation tags.
+    static_assert(sizeof(weos::memory_pool<double, 10>) < sizeof(pool_type),
+                  "A pool without handles must not store tags.");
+
+    pool_type p;
+    ASSERT_TRUE(p.from_handle(handle_type()) == 0);
+
+    void* chunks[10];
+    handle_type handles[10];
+    for (unsigned i = 0; i < 10; ++i)
+    {
+        chunks[i] = p.try_allocate();
+        handles[i] = p.to_handle(chunks[i]);
+        ASSERT_TRUE(bool(handles[i]));
+        for (unsigned j = 0; j < i; ++j)
+            ASSERT_TRUE(handles[i] != handles[j]);
+    }
+    for (unsigned i = 0; i < 10; ++i)
+        ASSERT_EQ(chunks[i], p.from_handle(handles[i]));
+
+    // A handle becomes stale when its chunk is freed, even if the same
+    // chunk is allocated again.
+    p.free(chunks[3]);
+    ASSERT_TRUE(p.from_handle(handles[3]) == 0);
+    void* chunk = p.try_allocate();
+    ASSERT_EQ(chunks[3], chunk);
+    ASSERT_TRUE(p.from_handle(handles[3]) == 0);
+    ASSERT_TRUE(p.to_handle(chunk) != handles[3]);
+    ASSERT_EQ(chunk, p.from_handle(p.to_handle(chunk)));
+
+    // The tag wraps around but never becomes zero.
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        p.free(chunk);
+        chunk = p.try_allocate();
+        ASSERT_NE(0, p.to_handle(chunk).tag());
+    }
+
+    p.clear();
+    for (unsigned i = 0; i < 10; ++i)
+        ASSERT_TRUE(p.from_handle(handles[i]) == 0);
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_ENABLE_POOL_STATISTICS
+#define WEOS_ENABLE_POOL_STATISTICS
+#endif // WEOS_ENABLE_POOL_STATISTICS
+
+#include <memorypool.hpp>
+#include <thread.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+template <typename T>
+class PoolStatisticsTestFixture : public testing::Test
+{
+};
+
+// Define a list of pools for which the statistics are tested.
+typedef testing::Types<
+    weos::memory_pool<int, 5>,
+    weos::shared_memory_pool<int, 5>,
+    weos::bitmap_memory_pool<int, 5>,
+    weos::magazine_memory_pool<int, 5, 4, 2> > TypesToTest;
+TYPED_TEST_CASE(PoolStatisticsTestFixture, TypesToTest);
+
+TYPED_TEST(PoolStatisticsTestFixture, Constructor)
+{
+    TypeParam pool;
+    weos::pool_statistics stats = pool.statistics();
+    ASSERT_EQ(0, stats.current_use);
+    ASSERT_EQ(0, stats.high_water_mark);
+    ASSERT_EQ(0, stats.allocation_failures);
+    ASSERT_EQ(0, stats.total_allocations);
+}
+
+TYPED_TEST(PoolStatisticsTestFixture, allocate_and_free)
+{
+    TypeParam pool;
+    std::vector<void*> chunks;
+    for (unsigned cnt = 0; cnt < 5; ++cnt)
+    {
+        void* chunk = pool.try_allocate();
+        ASSERT_TRUE(chunk != 0);
+        chunks.push_back(chunk);
+        ASSERT_EQ(cnt + 1, pool.statistics().current_use);
+        ASSERT_EQ(cnt + 1, pool.statistics().high_water_mark);
+    }
+
+    ASSERT_TRUE(pool.try_allocate() == 0);
+    ASSERT_TRUE(pool.try_allocate() == 0);
+    ASSERT_EQ(2, pool.statistics().allocation_failures);
+
+    for (unsigned cnt = 0; cnt < 3; ++cnt)
+    {
+        pool.free(chunks.back());
+        chunks.pop_back();
+    }
+
+    weos::pool_statistics stats = pool.statistics();
+    ASSERT_EQ(2, stats.current_use);
+    ASSERT_EQ(5, stats.high_water_mark);
+    ASSERT_EQ(2, stats.allocation_failures);
+    ASSERT_EQ(5, stats.total_allocations);
+
+    chunks.push_back(pool.try_allocate());
+    stats = pool.statistics();
+    ASSERT_EQ(3, stats.current_use);
+    ASSERT_EQ(5, stats.high_water_mark);
+    ASSERT_EQ(6, stats.total_allocations);
+}
+
+TEST(PoolStatistics, allocate_n_and_free_n)
+{
+    weos::shared_memory_pool<int, 5> pool;
+    void* chunks[6];
+
+    ASSERT_EQ(3, pool.try_allocate_n(chunks, 3));
+    ASSERT_EQ(3, pool.statistics().current_use);
+    ASSERT_EQ(0, pool.statistics().allocation_failures);
+
+    ASSERT_EQ(2, pool.try_allocate_n(chunks + 3, 3));
+    ASSERT_EQ(5, pool.statistics().current_use);
+    ASSERT_EQ(1, pool.statistics().allocation_failures);
+
+    pool.free_n(chunks, 5);
+    weos::pool_statistics stats = pool.statistics();
+    ASSERT_EQ(0, stats.current_use);
+    ASSERT_EQ(5, stats.high_water_mark);
+    ASSERT_EQ(5, stats.total_allocations);
+}
+
+TEST(PoolStatistics, concurrent_high_water_mark)
+{
+    typedef weos::shared_memory_pool<int, 100> pool_type;
+    pool_type pool;
+
+    auto worker = [&pool] {
+        for (unsigned iter = 0; iter < 1000; ++iter)
+        {
+            void* chunks[5];
+            for (unsigned idx = 0; idx < 5; ++idx)
+                chunks[idx] = pool.try_allocate();
+            for (unsigned idx = 0; idx < 5; ++idx)
+                pool.free(chunks[idx]);
+        }
+    };
+
+    weos::thread t1(worker);
+    weos::thread t2(worker);
+    weos::thread t3(worker);
+    weos::thread t4(worker);
+    t1.join();
+    t2.join();
+    t3.join();
+    t4.join();
+
+    weos::pool_statistics stats = pool.statistics();
+    ASSERT_EQ(0, stats.current_use);
+    ASSERT_LE(5, stats.high_water_mark);
+    ASSERT_GE(20, stats.high_water_mark);
+    ASSERT_EQ(0, stats.allocation_failures);
+    ASSERT_EQ(20000, stats.total_allocations);
+}
+
+TEST(PoolStatistics, dynamic_memory_pool)
+{
+    alignas(8) char memory[64];
+    weos::dynamic_memory_pool pool(memory, sizeof(memory), 16, 8);
+    void* chunk = pool.try_allocate();
+    ASSERT_EQ(1, pool.statistics().current_use);
+    pool.free(chunk);
+    ASSERT_EQ(0, pool.statistics().current_use);
+    ASSERT_EQ(1, pool.statistics().high_water_mark);
+}
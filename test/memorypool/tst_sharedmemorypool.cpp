@@ -26,12 +26,15 @@
   POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
+#include <chrono.hpp>
 #include <memorypool.hpp>
+#include <thread.hpp>
 
 #include "../common/testutils.hpp"
 #include "gtest/gtest.h"
 
 #include <set>
+#include <vector>
 
 template <typename T>
 class SharedMemoryPoolTestFixture : public testing::Test
@@ -145,6 +148,35 @@ TYPED_TEST(SharedMemoryPoolTestFixture, allocate_and_free)
     }
 }
 
+TYPED_TEST(SharedMemoryPoolTestFixture, allocate_n_and_free_n)
+{
+    const unsigned POOL_SIZE = 10;
+    weos::shared_memory_pool<TypeParam, POOL_SIZE> p;
+    void* chunks[POOL_SIZE + 1];
+    std::set<void*> uniqueChunks;
+
+    ASSERT_EQ(0, p.try_allocate_n(chunks, 0));
+    ASSERT_EQ(4, p.try_allocate_n(chunks, 4));
+    ASSERT_EQ(6, p.try_allocate_n(chunks + 4, 7));
+    ASSERT_TRUE(p.empty());
+    ASSERT_EQ(0, p.try_allocate_n(chunks, 1));
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+        uniqueChunks.insert(chunks[i]);
+    ASSERT_EQ(POOL_SIZE, uniqueChunks.size());
+
+    p.free_n(chunks, 3);
+    ASSERT_FALSE(p.empty());
+    p.free_n(chunks + 3, POOL_SIZE - 3);
+
+    for (unsigned i = 0; i < POOL_SIZE; ++i)
+    {
+        void* c = p.try_allocate();
+        ASSERT_TRUE(c != 0);
+        ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
+    }
+    ASSERT_TRUE(p.empty());
+}
+
 TYPED_TEST(SharedMemoryPoolTestFixture, random_allocate_and_free)
 {
     const unsigned POOL_SIZE = 10;
@@ -189,3 +221,228 @@ TYPED_TEST(SharedMemoryPoolTestFixture, random_allocate_and_free)
         ASSERT_EQ(POOL_SIZE, p.capacity());
     }
 }
+
+namespace
+{
+
+typedef weos::shared_memory_pool<std::uintptr_t, 20> concurrency_test_pool_t;
+
+// Allocates chunks from the pool, tags them with the given thread id and
+// checks that no other thread has changed the tag before freeing them again.
+void concurrent_allocate_and_free(concurrency_test_pool_t* p,
+                                  std::uintptr_t id, bool* ok)
+{
+    const unsigned NUM_CHUNKS = 4;
+    std::uintptr_t* chunks[NUM_CHUNKS];
+
+    for (unsigned i = 0; i < 10000; ++i)
+    {
+        unsigned numAllocated = 0;
+        for (; numAllocated < NUM_CHUNKS; ++numAllocated)
+        {
+            void* c = p->try_allocate();
+            if (c == 0)
+                break;
+            chunks[numAllocated] = static_cast<std::uintptr_t*>(c);
+            *chunks[numAllocated] = id;
+        }
+
+        for (unsigned j = 0; j < numAllocated; ++j)
+        {
+            if (*chunks[j] != id)
+                *ok = false;
+            p->free(chunks[j]);
+        }
+    }
+}
+
+} // anonymous namespace
+
+TEST(shared_memory_pool, concurrent_allocate_and_free)
+{
+    const unsigned NUM_THREADS = 4;
+    concurrency_test_pool_t p;
+    bool ok[NUM_THREADS];
+    weos::thread threads[NUM_THREADS];
+
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        ok[i] = true;
+        threads[i] = weos::thread(concurrent_allocate_and_free,
+                                  &p, std::uintptr_t(i + 1), &ok[i]);
+    }
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        threads[i].join();
+        ASSERT_TRUE(ok[i]);
+    }
+
+    // All chunks must have been returned to the pool.
+    for (unsigned i = 0; i < p.capacity(); ++i)
+        ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.empty());
+}
+
+TEST(shared_memory_pool, allocate_blocks_until_free)
+{
+    weos::shared_memory_pool<int, 2> p;
+    void* c1 = p.allocate();
+    void* c2 = p.allocate();
+    ASSERT_TRUE(c1 != 0);
+    ASSERT_TRUE(c2 != 0);
+    ASSERT_TRUE(p.empty());
+
+    weos::thread freer([&p, c2] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        p.free(c2);
+    });
+
+    void* c3 = p.allocate();
+    ASSERT_TRUE(c3 == c2);
+    freer.join();
+    p.free(c1);
+    p.free(c3);
+}
+
+TEST(shared_memory_pool, try_allocate_for)
+{
+    weos::shared_memory_pool<int, 1> p;
+    void* c1 = p.try_allocate_for(weos::chrono::milliseconds(1));
+    ASSERT_TRUE(c1 != 0);
+
+    auto start = weos::chrono::steady_clock::now();
+    ASSERT_TRUE(p.try_allocate_for(weos::chrono::milliseconds(20)) == 0);
+    ASSERT_TRUE(weos::chrono::steady_clock::now() - start
+                >= weos::chrono::milliseconds(20));
+
+    weos::thread freer([&p, c1] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        p.free(c1);
+    });
+    ASSERT_TRUE(p.try_allocate_for(weos::chrono::seconds(10)) == c1);
+    freer.join();
+}
+
+TEST(shared_memory_pool, try_allocate_until)
+{
+    weos::shared_memory_pool<int, 1> p;
+    void* c1 = p.try_allocate();
+    ASSERT_TRUE(c1 != 0);
+
+    ASSERT_TRUE(p.try_allocate_until(weos::chrono::steady_clock::now()
+                                     + weos::chrono::milliseconds(10)) == 0);
+    p.free(c1);
+    ASSERT_TRUE(p.try_allocate_until(weos::chrono::steady_clock::now()) == c1);
+}
+
+TEST(shared_memory_pool, concurrent_blocking_allocate)
+{
+    const unsigned NUM_THREADS = 4;
+    weos::shared_memory_pool<int, 2> p;
+    weos::thread threads[NUM_THREADS];
+
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        threads[i] = weos::thread([&p] {
+            for (unsigned iter = 0; iter < 1000; ++iter)
+                p.free(p.allocate());
+        });
+    }
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+        threads[i].join();
+
+    ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.empty());
+}
+
+TEST(shared_memory_pool, blocking_and_timed_allocate)
+{
+    // Threads which give up after a timeout must not swallow the
+    // notification of a chunk, which a blocked thread waits for.
+    const unsigned NUM_THREADS = 4;
+    weos::shared_memory_pool<int, 2> p;
+    weos::thread threads[NUM_THREADS];
+
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+    {
+        threads[i] = weos::thread([&p, i] {
+            for (unsigned iter = 0; iter < 500; ++iter)
+            {
+                void* chunk = i % 2
+                              ? p.try_allocate_for(weos::chrono::microseconds(50))
+                              : p.allocate();
+                if (chunk)
+                {
+                    weos::this_thread::yield();
+                    p.free(chunk);
+                }
+            }
+        });
+    }
+    for (unsigned i = 0; i < NUM_THREADS; ++i)
+        threads[i].join();
+
+    ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.try_allocate() != 0);
+    ASSERT_TRUE(p.empty());
+}
+
+namespace
+{
+// The constructor is a constant expression. Thus, this pool is
+// initialized statically.
+weos::shared_memory_pool<std::int32_t, 1000> static_shared_pool;
+} // anonymous namespace
+
+TEST(shared_memory_pool, static_pool)
+{
+    ASSERT_TRUE(testing::is_in_bss(&static_shared_pool));
+    ASSERT_FALSE(static_shared_pool.empty());
+
+    char* c1 = static_cast<char*>(static_shared_pool.try_allocate());
+    char* c2 = static_cast<char*>(static_shared_pool.try_allocate());
+    ASSERT_TRUE(c1 != 0);
+    ASSERT_TRUE(c2 > c1);
+
+    // A freed chunk is recycled before an untouched one.
+    static_shared_pool.free(c1);
+    ASSERT_TRUE(static_shared_pool.try_allocate() == c1);
+
+    static_shared_pool.free(c1);
+    static_shared_pool.free(c2);
+}
+
+TEST(shared_memory_pool, cacheline_aligned)
+{
+    weos::shared_memory_pool<std::int8_t, 4, weos::cacheline_aligned> p;
+    void* chunks[4];
+    ASSERT_EQ(4, p.try_allocate_n(chunks, 4));
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(chunks[i])
+                     % WEOS_CACHE_LINE_SIZE);
+        for (unsigned j = 0; j < i; ++j)
+            ASSERT_TRUE(chunks[i] != chunks[j]);
+    }
+    ASSERT_TRUE(p.empty());
+}
+
+TEST(shared_memory_pool, for_each_allocated_and_clear)
+{
+    weos::shared_memory_pool<std::int32_t, 10> p;
+    void* chunks[10];
+    ASSERT_EQ(10, p.try_allocate_n(chunks, 10));
+    for (unsigned i = 0; i < 10; i += 2)
+        p.free(chunks[i]);
+
+    std::vector<void*> visited;
+    p.for_each_allocated([&](void* c) { visited.push_back(c); });
+    ASSERT_EQ(5, visited.size());
+    for (unsigned i = 0; i < 5; ++i)
+        ASSERT_TRUE(visited[i] == chunks[2 * i + 1]);
+
+    p.clear();
+    ASSERT_EQ(10, p.try_allocate_n(chunks, 10));
+    ASSERT_TRUE(p.empty());
+}
@@ -0,0 +1,204 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <mailqueue.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+namespace
+{
+
+struct Mail
+{
+    Mail(int id, const char* text)
+        : id(id), text(text)
+    {
+        ++numLive;
+    }
+
+    ~Mail()
+    {
+        --numLive;
+    }
+
+    Mail(const Mail&) = delete;
+    Mail& operator=(const Mail&) = delete;
+
+    int id;
+    std::string text;
+
+    static int numLive;
+};
+
+int Mail::numLive = 0;
+
+struct Throwing
+{
+    Throwing(bool fail)
+    {
+        if (fail)
+            throw 42;
+    }
+};
+
+} // anonymous namespace
+
+TEST(mail_queue, Constructor)
+{
+    weos::mail_queue<Mail, 1> q1;
+    ASSERT_EQ(1, q1.capacity());
+
+    weos::mail_queue<Mail, 13> q13;
+    ASSERT_EQ(13, q13.capacity());
+    ASSERT_FALSE(q13.try_receive());
+}
+
+TEST(mail_queue, allocate_send_receive)
+{
+    Mail::numLive = 0;
+    {
+        weos::mail_queue<Mail, 3> q;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto mail = q.try_allocate(i, "mail");
+            ASSERT_TRUE(mail != nullptr);
+            q.send(std::move(mail));
+        }
+        ASSERT_FALSE(q.try_allocate(-1, "none"));
+        ASSERT_EQ(3, Mail::numLive);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            auto mail = q.receive();
+            ASSERT_EQ(i, mail->id);
+            ASSERT_EQ("mail", mail->text);
+        }
+        ASSERT_EQ(0, Mail::numLive);
+        ASSERT_FALSE(q.try_receive());
+
+        // All mails are free again.
+        for (int i = 0; i < 3; ++i)
+            q.send(q.allocate(i, "again"));
+    }
+    // The destructor destroys the mails which have not been received.
+    ASSERT_EQ(0, Mail::numLive);
+}
+
+TEST(mail_queue, raw_pointers)
+{
+    Mail::numLive = 0;
+    weos::mail_queue<Mail, 2> q;
+
+    Mail* mail = q.allocate(1, "raw").release();
+    q.send(mail);
+    Mail* received = q.try_receive().release();
+    ASSERT_EQ(mail, received);
+    ASSERT_EQ(1, Mail::numLive);
+    // Freeing returns the mail to a lock-free pool and never blocks.
+    static_assert(noexcept(q.free(received)), "free() must not throw.");
+    q.free(received);
+    ASSERT_EQ(0, Mail::numLive);
+}
+
+TEST(mail_queue, constructor_throws)
+{
+    weos::mail_queue<Throwing, 1> q;
+    ASSERT_THROW(q.allocate(true), int);
+    // The mail has been returned to the queue.
+    ASSERT_TRUE(q.try_allocate(false) != nullptr);
+}
+
+TEST(mail_queue, timeouts)
+{
+    weos::mail_queue<int, 1> q;
+    ASSERT_FALSE(q.try_receive_for(weos::chrono::milliseconds(10)));
+
+    auto mail = q.allocate(1);
+    ASSERT_FALSE(q.try_allocate_for(weos::chrono::milliseconds(10), 2));
+    q.send(std::move(mail));
+
+    mail = q.try_receive_until(weos::chrono::steady_clock::now()
+                               + weos::chrono::milliseconds(10));
+    ASSERT_TRUE(mail != nullptr);
+    ASSERT_EQ(1, *mail);
+}
+
+TEST(mail_queue, allocate_blocks_until_free)
+{
+    weos::mail_queue<int, 1> q;
+    q.send(q.allocate(1));
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.receive();
+    });
+    auto mail = q.allocate(2);
+    receiver.join();
+    ASSERT_EQ(2, *mail);
+}
+
+TEST(mail_queue, producers_and_consumers)
+{
+    const int NUM_PRODUCERS = 3;
+    const int NUM_MESSAGES = 10000;
+
+    weos::mail_queue<int, 4> q;
+    long sums[NUM_PRODUCERS] = {0};
+
+    weos::thread producers[NUM_PRODUCERS];
+    for (auto& producer : producers)
+    {
+        producer = weos::thread([&q] {
+            for (int i = 1; i <= NUM_MESSAGES; ++i)
+                q.send(q.allocate(i));
+        });
+    }
+
+    weos::thread consumers[NUM_PRODUCERS];
+    for (int idx = 0; idx < NUM_PRODUCERS; ++idx)
+    {
+        consumers[idx] = weos::thread([&q, &sums, idx] {
+            for (int i = 0; i < NUM_MESSAGES; ++i)
+                sums[idx] += *q.receive();
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+    long total = 0;
+    for (int idx = 0; idx < NUM_PRODUCERS; ++idx)
+    {
+        consumers[idx].join();
+        total += sums[idx];
+    }
+    ASSERT_EQ(long(NUM_PRODUCERS) * NUM_MESSAGES * (NUM_MESSAGES + 1) / 2,
+              total);
+    ASSERT_FALSE(q.try_receive());
+}
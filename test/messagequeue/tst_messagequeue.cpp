@@ -26,10 +26,18 @@
   POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
+#include <atomic.hpp>
 #include <messagequeue.hpp>
+#include <thread.hpp>
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
 TEST(aa, bb)
 {
     weos::message_queue<double, 1> q;
@@ -69,8 +77,556 @@ TEST(message_queue, put)
     ASSERT_TRUE(result);
     ASSERT_EQ(0x23456789, value);
 
-    /*q.send(0x34567890);
-    result = q.try_receive_for(weos::chrono::milliseconds(1));
+    q.send(0x34567890);
+    result = q.try_receive_for(value, weos::chrono::milliseconds(1));
     ASSERT_TRUE(result);
-    ASSERT_EQ(0x34567890, value);*/
+    ASSERT_EQ(0x34567890, value);
+}
+
+TEST(message_queue, fifo_order)
+{
+    weos::message_queue<int, 5> q;
+    for (unsigned round = 0; round < 10; ++round)
+    {
+        for (int i = 0; i < 5; ++i)
+            ASSERT_TRUE(q.try_send(i));
+        ASSERT_FALSE(q.try_send(5));
+        for (int i = 0; i < 5; ++i)
+            ASSERT_EQ(i, q.receive());
+        int value;
+        ASSERT_FALSE(q.try_receive(value));
+    }
+}
+
+TEST(message_queue, non_trivial_type)
+{
+    weos::message_queue<std::string, 3> q;
+    q.send(std::string(100, 'a'));
+    std::string s(50, 'b');
+    ASSERT_TRUE(q.try_send(s));
+    ASSERT_EQ(50, s.size());
+
+    ASSERT_EQ(std::string(100, 'a'), q.receive());
+    ASSERT_TRUE(q.try_receive(s));
+    ASSERT_EQ(std::string(50, 'b'), s);
+}
+
+TEST(message_queue, move_only_type)
+{
+    weos::message_queue<std::unique_ptr<int>, 2> q;
+    q.send(std::unique_ptr<int>(new int(1)));
+    std::unique_ptr<int> p(new int(2));
+    ASSERT_TRUE(q.try_send(std::move(p)));
+    ASSERT_TRUE(p == nullptr);
+
+    // A failed send must not move from the element.
+    p.reset(new int(3));
+    ASSERT_FALSE(q.try_send(std::move(p)));
+    ASSERT_TRUE(p != nullptr);
+
+    ASSERT_EQ(1, *q.receive());
+    ASSERT_EQ(2, *q.receive());
+}
+
+TEST(message_queue, destructor_destroys_elements)
+{
+    std::shared_ptr<int> p = std::make_shared<int>(1);
+    {
+        weos::message_queue<std::shared_ptr<int>, 4> q;
+        q.send(p);
+        q.send(p);
+        ASSERT_EQ(3, p.use_count());
+    }
+    ASSERT_EQ(1, p.use_count());
+}
+
+TEST(message_queue, receive_blocks_until_send)
+{
+    weos::message_queue<int, 1> q;
+    weos::thread sender([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.send(42);
+    });
+    ASSERT_EQ(42, q.receive());
+    sender.join();
+}
+
+TEST(message_queue, send_blocks_until_receive)
+{
+    weos::message_queue<int, 1> q;
+    q.send(1);
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.receive();
+    });
+    q.send(2);
+    receiver.join();
+    ASSERT_EQ(2, q.receive());
+}
+
+TEST(message_queue, multiple_producers_and_consumers)
+{
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 3;
+    const int NUM_MESSAGES = 20000;
+
+    weos::message_queue<int, 7> q;
+    weos::thread producers[NUM_PRODUCERS];
+    weos::thread consumers[NUM_CONSUMERS];
+    std::vector<int> received[NUM_CONSUMERS];
+
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        consumers[i] = weos::thread([&q, &received, i] {
+            for (;;)
+            {
+                int value = q.receive();
+                if (value < 0)
+                    break;
+                received[i].push_back(value);
+            }
+        });
+    }
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers[i] = weos::thread([&q, i] {
+            for (int j = 0; j < NUM_MESSAGES; ++j)
+                q.send(i * NUM_MESSAGES + j);
+        });
+    }
+
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+        producers[i].join();
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+        q.send(-1);
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+        consumers[i].join();
+
+    // Every message is received exactly once and the messages of one
+    // producer arrive at every consumer in order.
+    std::vector<int> count(NUM_PRODUCERS * NUM_MESSAGES, 0);
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        std::vector<int> last(NUM_PRODUCERS, -1);
+        for (int value : received[i])
+        {
+            ++count[value];
+            ASSERT_LT(last[value / NUM_MESSAGES], value);
+            last[value / NUM_MESSAGES] = value;
+        }
+    }
+    for (int c : count)
+        ASSERT_EQ(1, c);
+}
+
+TEST(message_queue, send_n_and_receive_n)
+{
+    weos::message_queue<std::string, 5> q;
+    std::vector<std::string> in = {"a", "b", "c", "d", "e", "f", "g"};
+
+    ASSERT_EQ(5, q.try_send_n(in.begin(), in.end()));
+    ASSERT_EQ(0, q.try_send_n(in.begin(), in.end()));
+    ASSERT_EQ("a", in[0]);
+
+    std::vector<std::string> out;
+    ASSERT_EQ(2, q.receive_n(std::back_inserter(out), 2));
+    ASSERT_EQ(3, q.receive_n(std::back_inserter(out), 10));
+    ASSERT_EQ(0, q.receive_n(std::back_inserter(out), 0));
+    ASSERT_EQ(std::vector<std::string>(in.begin(), in.begin() + 5), out);
+
+    // The slots wrap around.
+    q.send_n(in.begin(), in.begin() + 4);
+    out.clear();
+    ASSERT_EQ(4, q.drain([&out](std::string&& s) { out.push_back(s); }));
+    ASSERT_EQ(0, q.drain([](std::string&&) { FAIL(); }));
+    ASSERT_EQ(std::vector<std::string>(in.begin(), in.begin() + 4), out);
+}
+
+TEST(message_queue, send_n_blocks_until_receive)
+{
+    const int NUM_MESSAGES = 1000;
+
+    weos::message_queue<int, 7> q;
+    weos::thread receiver([&q] {
+        int expected = 0;
+        int buffer[5];
+        while (expected < NUM_MESSAGES)
+        {
+            std::size_t count = q.receive_n(buffer, 5);
+            for (std::size_t i = 0; i < count; ++i)
+                ASSERT_EQ(expected++, buffer[i]);
+        }
+    });
+
+    std::vector<int> values;
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+        values.push_back(i);
+    q.send_n(values.begin(), values.end());
+    receiver.join();
+
+    int value;
+    ASSERT_FALSE(q.try_receive(value));
+}
+
+TEST(message_queue, concurrent_batches)
+{
+    const int NUM_PRODUCERS = 4;
+    const int NUM_CONSUMERS = 2;
+    const int NUM_BATCHES = 2000;
+    const int BATCH_SIZE = 5;
+
+    weos::message_queue<int, 11> q;
+    weos::thread producers[NUM_PRODUCERS];
+    weos::thread consumers[NUM_CONSUMERS];
+    std::vector<int> received[NUM_CONSUMERS];
+
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        consumers[i] = weos::thread([&q, &received, i] {
+            for (;;)
+            {
+                int buffer[3];
+                std::size_t count = q.receive_n(buffer, 3);
+                for (std::size_t j = 0; j < count; ++j)
+                {
+                    if (buffer[j] < 0)
+                        return;
+                    received[i].push_back(buffer[j]);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers[i] = weos::thread([&q, i] {
+            for (int j = 0; j < NUM_BATCHES; ++j)
+            {
+                int batch[BATCH_SIZE];
+                for (int k = 0; k < BATCH_SIZE; ++k)
+                    batch[k] = (i * NUM_BATCHES + j) * BATCH_SIZE + k;
+                q.send_n(batch, batch + BATCH_SIZE);
+            }
+        });
+    }
+
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+        producers[i].join();
+    // A consumer stops at the first negative value, which it receives, and
+    // drops the rest of its batch. Send enough of them.
+    for (int i = 0; i < 3 * NUM_CONSUMERS; ++i)
+        q.send(-1);
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+        consumers[i].join();
+
+    std::vector<int> count(NUM_PRODUCERS * NUM_BATCHES * BATCH_SIZE, 0);
+    for (int i = 0; i < NUM_CONSUMERS; ++i)
+        for (int value : received[i])
+            ++count[value];
+    for (int c : count)
+        ASSERT_EQ(1, c);
+}
+
+TEST(message_queue, try_receive_for)
+{
+    weos::message_queue<std::string, 2> q;
+    std::string value;
+
+    auto start = weos::chrono::steady_clock::now();
+    ASSERT_FALSE(q.try_receive_for(value, weos::chrono::milliseconds(20)));
+    ASSERT_TRUE(weos::chrono::steady_clock::now() - start
+                >= weos::chrono::milliseconds(20));
+
+    weos::thread sender([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        q.send("abc");
+    });
+    ASSERT_TRUE(q.try_receive_for(value, weos::chrono::seconds(10)));
+    ASSERT_EQ("abc", value);
+    sender.join();
+}
+
+TEST(message_queue, try_receive_until)
+{
+    weos::message_queue<int, 2> q;
+    int value;
+
+    ASSERT_FALSE(q.try_receive_until(
+                     value,
+                     weos::chrono::steady_clock::now() + weos::chrono::milliseconds(10)));
+    q.send(3);
+    ASSERT_TRUE(q.try_receive_until(value, weos::chrono::steady_clock::now()));
+    ASSERT_EQ(3, value);
+}
+
+TEST(message_queue, try_send_for)
+{
+    weos::message_queue<std::unique_ptr<int>, 1> q;
+    q.send(std::unique_ptr<int>(new int(1)));
+
+    std::unique_ptr<int> p(new int(2));
+    ASSERT_FALSE(q.try_send_for(std::move(p), weos::chrono::milliseconds(10)));
+    ASSERT_TRUE(p != nullptr);
+
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        q.receive();
+    });
+    ASSERT_TRUE(q.try_send_for(std::move(p), weos::chrono::seconds(10)));
+    ASSERT_TRUE(p == nullptr);
+    receiver.join();
+    ASSERT_EQ(2, *q.receive());
+}
+
+TEST(message_queue, try_send_until)
+{
+    weos::message_queue<int, 1> q;
+    ASSERT_TRUE(q.try_send_until(1, weos::chrono::steady_clock::now()));
+    ASSERT_FALSE(q.try_send_until(
+                     2,
+                     weos::chrono::steady_clock::now() + weos::chrono::milliseconds(10)));
+    ASSERT_EQ(1, q.receive());
+}
+
+TEST(message_queue, timed_producers_and_consumers)
+{
+    const int NUM_THREADS = 3;
+    const int NUM_MESSAGES = 5000;
+
+    weos::message_queue<int, 4> q;
+    weos::thread producers[NUM_THREADS];
+    weos::thread consumers[NUM_THREADS];
+    weos::atomic<int> sum(0);
+
+    for (int i = 0; i < NUM_THREADS; ++i)
+    {
+        consumers[i] = weos::thread([&q, &sum] {
+            for (int j = 0; j < NUM_MESSAGES; ++j)
+            {
+                int value;
+                while (!q.try_receive_for(value, weos::chrono::milliseconds(1)))
+                {
+                }
+                sum += value;
+            }
+        });
+        producers[i] = weos::thread([&q] {
+            for (int j = 0; j < NUM_MESSAGES; ++j)
+                while (!q.try_send_for(1, weos::chrono::milliseconds(1)))
+                {
+                }
+        });
+    }
+    for (int i = 0; i < NUM_THREADS; ++i)
+    {
+        producers[i].join();
+        consumers[i].join();
+    }
+    ASSERT_EQ(NUM_THREADS * NUM_MESSAGES, sum);
+}
+
+namespace
+{
+
+struct Frame
+{
+    Frame() noexcept
+        : id(0)
+    {
+        ++numConstructions;
+    }
+
+    Frame(int i, char fill) noexcept
+        : id(i)
+    {
+        ++numConstructions;
+        std::fill(data, data + sizeof(data), fill);
+    }
+
+    Frame(const Frame& other) noexcept
+        : id(other.id)
+    {
+        ++numCopies;
+        std::copy(other.data, other.data + sizeof(data), data);
+    }
+
+    int id;
+    char data[256];
+
+    static int numConstructions;
+    static int numCopies;
+};
+
+int Frame::numConstructions = 0;
+int Frame::numCopies = 0;
+
+} // anonymous namespace
+
+TEST(message_queue, emplace_and_consume)
+{
+    Frame::numConstructions = 0;
+    Frame::numCopies = 0;
+
+    weos::message_queue<Frame, 2> q;
+    q.emplace(1, 'a');
+    ASSERT_TRUE(q.try_emplace(2, 'b'));
+    ASSERT_FALSE(q.try_emplace(3, 'c'));
+
+    q.consume([](Frame& f) {
+        ASSERT_EQ(1, f.id);
+        ASSERT_EQ('a', f.data[255]);
+    });
+    ASSERT_TRUE(q.try_consume([](const Frame& f) {
+        ASSERT_EQ(2, f.id);
+        ASSERT_EQ('b', f.data[0]);
+    }));
+    ASSERT_FALSE(q.try_consume([](Frame&) { FAIL(); }));
+
+    // The frames have never been copied.
+    ASSERT_EQ(2, Frame::numConstructions);
+    ASSERT_EQ(0, Frame::numCopies);
+}
+
+TEST(message_queue, reserve_and_commit)
+{
+    Frame::numCopies = 0;
+
+    weos::message_queue<Frame, 2> q;
+    {
+        weos::message_queue<Frame, 2>::reservation r = q.reserve();
+        r->id = 7;
+        (*r).data[0] = 'x';
+
+        // The element is not visible before the commit.
+        ASSERT_FALSE(q.try_consume([](Frame&) {}));
+        r.commit();
+        r.commit();
+    }
+    {
+        // An uncommitted reservation is rolled back upon destruction.
+        weos::message_queue<Frame, 2>::reservation r = q.reserve();
+        r->id = 8;
+    }
+
+    q.consume([](Frame& f) {
+        ASSERT_EQ(7, f.id);
+        ASSERT_EQ('x', f.data[0]);
+    });
+    ASSERT_FALSE(q.try_consume([](Frame&) {}));
+    ASSERT_EQ(0, Frame::numCopies);
+}
+
+TEST(message_queue, reserve_rolls_back_on_exception)
+{
+    weos::message_queue<std::shared_ptr<int>, 2> q;
+    std::shared_ptr<int> p = std::make_shared<int>(1);
+
+    for (int round = 0; round < 5; ++round)
+    {
+        try
+        {
+            weos::message_queue<std::shared_ptr<int>, 2>::reservation r
+                    = q.reserve();
+            *r = p;
+            throw 1;
+        }
+        catch (int)
+        {
+        }
+        ASSERT_EQ(1, p.use_count());
+
+        weos::message_queue<std::shared_ptr<int>, 2>::reservation r
+                = q.reserve();
+        *r = std::make_shared<int>(round);
+        r.commit();
+
+        // Only the committed element is received.
+        std::shared_ptr<int> value = q.receive();
+        ASSERT_EQ(round, *value);
+        ASSERT_FALSE(q.try_receive(value));
+    }
+}
+
+TEST(message_queue, consume_releases_slot_on_exception)
+{
+    weos::message_queue<std::shared_ptr<int>, 1> q;
+    std::shared_ptr<int> p = std::make_shared<int>(1);
+    q.send(p);
+    ASSERT_EQ(2, p.use_count());
+
+    ASSERT_THROW(q.consume([](std::shared_ptr<int>&) { throw 1; }), int);
+    ASSERT_EQ(1, p.use_count());
+    ASSERT_TRUE(q.try_send(p));
+}
+
+namespace
+{
+
+// A type whose move assignment throws on request.
+struct ThrowingAssignment
+{
+    explicit ThrowingAssignment(bool t = false) noexcept
+        : doThrow(t)
+    {
+    }
+
+    ThrowingAssignment(ThrowingAssignment&& other) noexcept
+        : doThrow(other.doThrow)
+    {
+    }
+
+    ThrowingAssignment& operator=(ThrowingAssignment&& other)
+    {
+        if (other.doThrow)
+            throw 1;
+        doThrow = other.doThrow;
+        return *this;
+    }
+
+    bool doThrow;
+};
+
+} // anonymous namespace
+
+TEST(message_queue, try_receive_releases_slot_on_exception)
+{
+    weos::message_queue<ThrowingAssignment, 1> q;
+    ThrowingAssignment value;
+
+    q.send(ThrowingAssignment(true));
+    ASSERT_THROW(q.try_receive(value), int);
+    ASSERT_TRUE(q.try_send(ThrowingAssignment(true)));
+    ASSERT_THROW(q.try_receive_for(value, weos::chrono::milliseconds(1)), int);
+
+    // The slots have been released, so the queue keeps working.
+    ASSERT_TRUE(q.try_send(ThrowingAssignment(false)));
+    ASSERT_TRUE(q.try_receive(value));
+    ASSERT_FALSE(q.try_receive(value));
+}
+
+TEST(message_queue, blocked_receiver_skips_rolled_back_reservation)
+{
+    weos::message_queue<int, 2> q;
+    weos::thread receiver([&q] { ASSERT_EQ(2, q.receive()); });
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    {
+        weos::message_queue<int, 2>::reservation r = q.reserve();
+        *r = 1;
+    }
+    q.send(2);
+    receiver.join();
+}
+
+TEST(message_queue, reserve_blocks_until_receive)
+{
+    weos::message_queue<Frame, 1> q;
+    q.emplace(1, 'a');
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        q.consume([](Frame& f) { ASSERT_EQ(1, f.id); });
+        q.consume([](Frame& f) { ASSERT_EQ(2, f.id); });
+    });
+    weos::message_queue<Frame, 1>::reservation r = q.reserve();
+    r->id = 2;
+    r.commit();
+    receiver.join();
 }
@@ -0,0 +1,181 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#ifndef WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+#define WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+#endif // WEOS_ENABLE_MESSAGE_QUEUE_STATISTICS
+
+#include <messagequeue.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+namespace
+{
+
+std::size_t num_latencies(const weos::message_queue_statistics& stats)
+{
+    std::size_t sum = 0;
+    for (std::size_t count : stats.latency_histogram)
+        sum += count;
+    return sum;
+}
+
+} // anonymous namespace
+
+TEST(message_queue_statistics, Constructor)
+{
+    weos::message_queue<int, 5> q;
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(0, stats.current_size);
+    ASSERT_EQ(0, stats.high_water_mark);
+    ASSERT_EQ(0, stats.send_stalls);
+    ASSERT_EQ(0, num_latencies(stats));
+}
+
+TEST(message_queue_statistics, send_and_receive)
+{
+    weos::message_queue<int, 5> q;
+    for (int cnt = 0; cnt < 4; ++cnt)
+    {
+        q.send(cnt);
+        weos::message_queue_statistics stats = q.statistics();
+        ASSERT_EQ(cnt + 1, stats.current_size);
+        ASSERT_EQ(cnt + 1, stats.high_water_mark);
+    }
+
+    for (int cnt = 0; cnt < 4; ++cnt)
+    {
+        ASSERT_EQ(cnt, q.receive());
+        weos::message_queue_statistics stats = q.statistics();
+        ASSERT_EQ(3 - cnt, stats.current_size);
+        ASSERT_EQ(4, stats.high_water_mark);
+        ASSERT_EQ(cnt + 1, num_latencies(stats));
+    }
+
+    q.send(42);
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(1, stats.current_size);
+    ASSERT_EQ(4, stats.high_water_mark);
+    ASSERT_EQ(0, stats.send_stalls);
+}
+
+TEST(message_queue_statistics, batches_and_in_place_operations)
+{
+    weos::message_queue<int, 5> q;
+    std::vector<int> input{1, 2, 3};
+    q.send_n(input.begin(), input.end());
+    {
+        auto r = q.reserve();
+        *r = 4;
+        r.commit();
+    }
+    ASSERT_EQ(4, q.statistics().current_size);
+
+    q.consume([](int&) {});
+    ASSERT_EQ(3, q.statistics().current_size);
+
+    ASSERT_EQ(3, q.drain([](int&&) {}));
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(0, stats.current_size);
+    ASSERT_EQ(4, stats.high_water_mark);
+    ASSERT_EQ(4, num_latencies(stats));
+}
+
+TEST(message_queue_statistics, send_stalls)
+{
+    weos::message_queue<int, 2> q;
+    ASSERT_TRUE(q.try_send(1));
+    ASSERT_TRUE(q.try_send(2));
+    ASSERT_EQ(0, q.statistics().send_stalls);
+
+    ASSERT_FALSE(q.try_send(3));
+    ASSERT_EQ(1, q.statistics().send_stalls);
+
+    ASSERT_FALSE(q.try_send_for(3, weos::chrono::milliseconds(1)));
+    ASSERT_EQ(2, q.statistics().send_stalls);
+
+    std::vector<int> input{3, 4};
+    ASSERT_EQ(0, q.try_send_n(input.begin(), input.end()));
+    ASSERT_EQ(3, q.statistics().send_stalls);
+
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.receive();
+    });
+    q.send(3);
+    receiver.join();
+
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(4, stats.send_stalls);
+    ASSERT_EQ(2, stats.current_size);
+    ASSERT_EQ(2, stats.high_water_mark);
+}
+
+TEST(message_queue_statistics, latency_histogram)
+{
+    weos::message_queue<int, 2> q;
+    q.send(1);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+    q.receive();
+
+    // 20ms lie in the bucket [2^14, 2^15) us. Sleeping can take longer but
+    // never shorter.
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(1, num_latencies(stats));
+    for (std::size_t idx = 0; idx < 15; ++idx)
+        ASSERT_EQ(0, stats.latency_histogram[idx]);
+}
+
+TEST(message_queue_statistics, concurrent_senders_and_receivers)
+{
+    static const int NUM_PRODUCERS = 3;
+    static const int NUM_MESSAGES = 1000;
+
+    weos::message_queue<int, 4> q;
+    weos::thread producers[NUM_PRODUCERS];
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producers[i] = weos::thread([&q] {
+            for (int cnt = 0; cnt < NUM_MESSAGES; ++cnt)
+                q.send(cnt);
+        });
+    }
+
+    for (int cnt = 0; cnt < NUM_PRODUCERS * NUM_MESSAGES; ++cnt)
+        q.receive();
+    for (int i = 0; i < NUM_PRODUCERS; ++i)
+        producers[i].join();
+
+    weos::message_queue_statistics stats = q.statistics();
+    ASSERT_EQ(0, stats.current_size);
+    ASSERT_LE(stats.high_water_mark, 4);
+    ASSERT_EQ(NUM_PRODUCERS * NUM_MESSAGES, num_latencies(stats));
+}
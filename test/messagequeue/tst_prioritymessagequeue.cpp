@@ -0,0 +1,179 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+TEST(priority_message_queue, Constructor)
+{
+    weos::priority_message_queue<int, 1, 1> q1;
+    ASSERT_EQ(1, q1.capacity());
+    ASSERT_EQ(1, q1.levels());
+
+    weos::priority_message_queue<int, 13, 32> q13;
+    ASSERT_EQ(13, q13.capacity());
+    ASSERT_EQ(32, q13.levels());
+
+    int value;
+    ASSERT_FALSE(q13.try_receive(value));
+}
+
+TEST(priority_message_queue, highest_level_first)
+{
+    weos::priority_message_queue<int, 4, 8> q;
+    q.send(10, 1);
+    q.send(11, 1);
+    q.send(0);
+    q.send(70, 7);
+    q.send(40, 4);
+    q.send(71, 7);
+
+    ASSERT_EQ(70, q.receive());
+    ASSERT_EQ(71, q.receive());
+    ASSERT_EQ(40, q.receive());
+    q.send(50, 5);
+    ASSERT_EQ(50, q.receive());
+    ASSERT_EQ(10, q.receive());
+    ASSERT_EQ(11, q.receive());
+    ASSERT_EQ(0, q.receive());
+
+    int value;
+    ASSERT_FALSE(q.try_receive(value));
+}
+
+TEST(priority_message_queue, levels_have_separate_capacity)
+{
+    weos::priority_message_queue<std::string, 2, 2> q;
+    ASSERT_TRUE(q.try_send("a"));
+    ASSERT_TRUE(q.try_send("b"));
+    ASSERT_FALSE(q.try_send("c"));
+
+    // A full level does not block the other level.
+    ASSERT_TRUE(q.try_send("urgent", 1));
+
+    std::string value;
+    ASSERT_TRUE(q.try_receive(value));
+    ASSERT_EQ("urgent", value);
+    ASSERT_TRUE(q.try_receive(value));
+    ASSERT_EQ("a", value);
+    ASSERT_TRUE(q.try_send("c"));
+}
+
+TEST(priority_message_queue, timeouts)
+{
+    weos::priority_message_queue<int, 1, 2> q;
+
+    int value;
+    ASSERT_FALSE(q.try_receive_for(value, weos::chrono::milliseconds(10)));
+
+    ASSERT_TRUE(q.try_send_for(1, weos::chrono::milliseconds(10)));
+    ASSERT_FALSE(q.try_send_for(2, weos::chrono::milliseconds(10)));
+    ASSERT_TRUE(q.try_send_until(3, weos::chrono::steady_clock::now(), 1));
+
+    ASSERT_TRUE(q.try_receive_until(value, weos::chrono::steady_clock::now()
+                                           + weos::chrono::milliseconds(10)));
+    ASSERT_EQ(3, value);
+    ASSERT_TRUE(q.try_receive_for(value, weos::chrono::milliseconds(10)));
+    ASSERT_EQ(1, value);
+}
+
+TEST(priority_message_queue, receive_blocks_until_send)
+{
+    weos::priority_message_queue<int, 1, 4> q;
+    weos::thread sender([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.send(3, 3);
+    });
+    ASSERT_EQ(3, q.receive());
+    sender.join();
+}
+
+TEST(priority_message_queue, consume_wakes_blocked_sender_on_exception)
+{
+    weos::priority_message_queue<int, 1, 2> q;
+    q.send(1, 1);
+    weos::thread sender([&q] {
+        q.send(2, 1);
+    });
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+
+    // The slot is released and the sender of the level is woken although
+    // the consumer throws.
+    ASSERT_THROW(q.consume([](int&) { throw 1; }), int);
+    sender.join();
+
+    int value;
+    ASSERT_TRUE(q.try_receive(value));
+    ASSERT_EQ(2, value);
+    ASSERT_FALSE(q.try_receive(value));
+}
+
+TEST(priority_message_queue, producers_and_consumers)
+{
+    const int NUM_LEVELS = 4;
+    const int NUM_MESSAGES = 10000;
+
+    weos::priority_message_queue<int, 3, NUM_LEVELS> q;
+    long sums[NUM_LEVELS] = {0};
+
+    weos::thread producers[NUM_LEVELS];
+    for (int level = 0; level < NUM_LEVELS; ++level)
+    {
+        producers[level] = weos::thread([&q, level] {
+            for (int i = 1; i <= NUM_MESSAGES; ++i)
+                q.send(i, level);
+        });
+    }
+
+    weos::thread consumers[NUM_LEVELS];
+    for (int idx = 0; idx < NUM_LEVELS; ++idx)
+    {
+        consumers[idx] = weos::thread([&q, &sums, idx] {
+            for (int i = 0; i < NUM_MESSAGES; ++i)
+                sums[idx] += q.receive();
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+    long total = 0;
+    for (int idx = 0; idx < NUM_LEVELS; ++idx)
+    {
+        consumers[idx].join();
+        total += sums[idx];
+    }
+    ASSERT_EQ(long(NUM_LEVELS) * NUM_MESSAGES * (NUM_MESSAGES + 1) / 2,
+              total);
+
+    int value;
+    ASSERT_FALSE(q.try_receive(value));
+}
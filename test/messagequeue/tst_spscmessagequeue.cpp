@@ -0,0 +1,177 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <messagequeue.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <string>
+
+TEST(spsc_message_queue, Constructor)
+{
+    weos::spsc_message_queue<std::int32_t, 1> q1;
+    ASSERT_EQ(1, q1.capacity());
+
+    weos::spsc_message_queue<std::int32_t, 13> q13;
+    ASSERT_EQ(13, q13.capacity());
+
+    std::int32_t value;
+    ASSERT_FALSE(q13.try_receive(value));
+}
+
+TEST(spsc_message_queue, fifo_order)
+{
+    weos::spsc_message_queue<int, 3> q;
+    for (int round = 0; round < 10; ++round)
+    {
+        for (int i = 0; i < 3; ++i)
+            ASSERT_TRUE(q.try_send(round + i));
+        ASSERT_FALSE(q.try_send(-1));
+        for (int i = 0; i < 3; ++i)
+            ASSERT_EQ(round + i, q.receive());
+        int value;
+        ASSERT_FALSE(q.try_receive(value));
+    }
+}
+
+TEST(spsc_message_queue, non_trivial_type)
+{
+    std::shared_ptr<int> p = std::make_shared<int>(1);
+    {
+        weos::spsc_message_queue<std::shared_ptr<int>, 2> q;
+        q.send(p);
+        ASSERT_TRUE(q.try_send(p));
+        ASSERT_FALSE(q.try_send(p));
+        ASSERT_EQ(3, p.use_count());
+
+        ASSERT_EQ(p, q.receive());
+        ASSERT_EQ(2, p.use_count());
+    }
+    ASSERT_EQ(1, p.use_count());
+}
+
+namespace
+{
+
+// A type whose move assignment throws on request.
+struct ThrowingAssignment
+{
+    explicit ThrowingAssignment(bool t = false) noexcept
+        : doThrow(t)
+    {
+    }
+
+    ThrowingAssignment(ThrowingAssignment&& other) noexcept
+        : doThrow(other.doThrow)
+    {
+    }
+
+    ThrowingAssignment& operator=(ThrowingAssignment&& other)
+    {
+        if (other.doThrow)
+            throw 1;
+        doThrow = other.doThrow;
+        return *this;
+    }
+
+    bool doThrow;
+};
+
+} // anonymous namespace
+
+TEST(spsc_message_queue, try_receive_releases_slot_on_exception)
+{
+    weos::spsc_message_queue<ThrowingAssignment, 1> q;
+    ThrowingAssignment value;
+
+    q.send(ThrowingAssignment(true));
+    ASSERT_THROW(q.try_receive(value), int);
+
+    // The slot has been released, so the queue keeps working.
+    ASSERT_TRUE(q.try_send(ThrowingAssignment(false)));
+    ASSERT_TRUE(q.try_receive(value));
+}
+
+TEST(spsc_message_queue, receive_blocks_until_send)
+{
+    weos::spsc_message_queue<std::string, 1> q;
+    weos::thread sender([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.send("hello");
+    });
+    ASSERT_EQ("hello", q.receive());
+    sender.join();
+}
+
+TEST(spsc_message_queue, send_blocks_until_receive)
+{
+    weos::spsc_message_queue<int, 1> q;
+    q.send(1);
+    weos::thread receiver([&q] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(20));
+        q.receive();
+    });
+    q.send(2);
+    receiver.join();
+    ASSERT_EQ(2, q.receive());
+}
+
+TEST(spsc_message_queue, producer_and_consumer)
+{
+    const int NUM_MESSAGES = 100000;
+
+    weos::spsc_message_queue<int, 10> q;
+    weos::thread producer([&q] {
+        for (int i = 0; i < NUM_MESSAGES; ++i)
+        {
+            if (i % 2)
+                q.send(i);
+            else
+                while (!q.try_send(i))
+                    weos::this_thread::yield();
+        }
+    });
+
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+    {
+        if (i % 3)
+        {
+            ASSERT_EQ(i, q.receive());
+        }
+        else
+        {
+            int value;
+            while (!q.try_receive(value))
+                weos::this_thread::yield();
+            ASSERT_EQ(i, value);
+        }
+    }
+    producer.join();
+}
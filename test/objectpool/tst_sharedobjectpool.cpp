@@ -26,12 +26,15 @@
   POSSIBILITY OF SUCH DAMAGE.
 *******************************************************************************/
 
+#include <chrono.hpp>
 #include <objectpool.hpp>
+#include <thread.hpp>
 
 #include "../common/testutils.hpp"
 #include "gtest/gtest.h"
 
 #include <set>
+#include <vector>
 
 typedef double typeToTest;
 
@@ -40,10 +43,9 @@ TEST(shared_object_pool, Constructor)
     weos::shared_object_pool<typeToTest, 10> p;
     ASSERT_FALSE(p.empty());
     ASSERT_EQ(10, p.capacity());
-    ASSERT_EQ(10, p.size());
 }
 
-TEST(shared_object_pool, allocate)
+TEST(shared_object_pool, construct)
 {
     const unsigned POOL_SIZE = 10;
     weos::shared_object_pool<typeToTest, POOL_SIZE> p;
@@ -51,11 +53,9 @@ TEST(shared_object_pool, allocate)
 
     for (unsigned i = 0; i < POOL_SIZE; ++i)
     {
-        ASSERT_EQ(POOL_SIZE - i, p.size());
         ASSERT_FALSE(p.empty());
-        void* c = p.allocate();
+        void* c = p.construct();
         ASSERT_TRUE(c != 0);
-        ASSERT_EQ(POOL_SIZE - i - 1, p.size());
 
         // Check the alignment of the allocated chunk.
         char* addr = static_cast<char*>(c);
@@ -79,21 +79,21 @@ TEST(shared_object_pool, allocate)
     ASSERT_TRUE(p.empty());
 }
 
-TEST(shared_object_pool, try_allocate)
+TEST(shared_object_pool, try_construct)
 {
     const unsigned POOL_SIZE = 10;
     weos::shared_object_pool<typeToTest, POOL_SIZE> p;
 
     for (unsigned i = 0; i < POOL_SIZE; ++i)
     {
-        void* c = p.try_allocate();
+        void* c = p.try_construct();
         ASSERT_TRUE(c != 0);
     }
     ASSERT_TRUE(p.empty());
 
     for (unsigned i = 0; i < POOL_SIZE; ++i)
     {
-        ASSERT_TRUE(p.try_allocate() == 0);
+        ASSERT_TRUE(p.try_construct() == 0);
     }
 }
 
@@ -107,17 +107,13 @@ TEST(shared_object_pool, allocate_and_free)
     {
         for (unsigned i = 0; i < j; ++i)
         {
-            ASSERT_EQ(POOL_SIZE - i, p.size());
-            typeToTest* c = p.allocate();
+            typeToTest* c = p.construct();
             ASSERT_TRUE(c != 0);
-            ASSERT_EQ(POOL_SIZE - i - 1, p.size());
             chunks[i] = c;
         }
         for (unsigned i = 0; i < j; ++i)
         {
-            ASSERT_EQ(POOL_SIZE - j + i, p.size());
-            p.free(chunks[i]);
-            ASSERT_EQ(POOL_SIZE - j + i + 1, p.size());
+            p.destroy(chunks[i]);
         }
     }
 }
@@ -128,11 +124,10 @@ TEST(shared_object_pool, random_allocate_and_free)
     weos::shared_object_pool<typeToTest, POOL_SIZE> p;
     typeToTest* chunks[POOL_SIZE];
     std::set<void*> uniqueChunks;
-    int numAllocatedChunks = 0;
 
     for (unsigned i = 0; i < POOL_SIZE; ++i)
     {
-        typeToTest* c = p.allocate();
+        typeToTest* c = p.construct();
         ASSERT_TRUE(c != 0);
         chunks[i] = c;
         uniqueChunks.insert(c);
@@ -141,7 +136,7 @@ TEST(shared_object_pool, random_allocate_and_free)
     ASSERT_EQ(POOL_SIZE, uniqueChunks.size());
     for (unsigned i = 0; i < POOL_SIZE; ++i)
     {
-        p.free(chunks[i]);
+        p.destroy(chunks[i]);
         chunks[i] = 0;
     }
 
@@ -150,18 +145,237 @@ TEST(shared_object_pool, random_allocate_and_free)
         unsigned index = random() % POOL_SIZE;
         if (chunks[index] == 0)
         {
-            typeToTest* c = p.allocate();
+            typeToTest* c = p.construct();
             ASSERT_TRUE(c != 0);
             ASSERT_TRUE(uniqueChunks.find(c) != uniqueChunks.end());
             chunks[index] = c;
-            ++numAllocatedChunks;
         }
         else
         {
-            p.free(chunks[index]);
+            p.destroy(chunks[index]);
             chunks[index] = 0;
-            --numAllocatedChunks;
         }
-        ASSERT_EQ(POOL_SIZE - numAllocatedChunks, p.size());
     }
 }
+
+namespace
+{
+
+struct Counted
+{
+    explicit Counted(int v)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    ~Counted()
+    {
+        --numInstances;
+    }
+
+    int value;
+    static int numInstances;
+};
+
+int Counted::numInstances = 0;
+
+} // anonymous namespace
+
+TEST(shared_object_pool, for_each_live)
+{
+    weos::shared_object_pool<Counted, 10> p;
+    Counted* objects[10];
+    for (int i = 0; i < 10; ++i)
+        objects[i] = p.try_construct(i);
+
+    // Destroy every third object.
+    for (int i = 0; i < 10; i += 3)
+        p.destroy(objects[i]);
+
+    std::vector<int> values;
+    Counted* previous = 0;
+    p.for_each_live([&](Counted& c) {
+        // The objects are visited in the order of increasing addresses.
+        ASSERT_TRUE(previous < &c);
+        previous = &c;
+        values.push_back(c.value);
+    });
+    ASSERT_EQ(6, values.size());
+    ASSERT_EQ(1, values[0]);
+    ASSERT_EQ(2, values[1]);
+    ASSERT_EQ(4, values[2]);
+    ASSERT_EQ(5, values[3]);
+    ASSERT_EQ(7, values[4]);
+    ASSERT_EQ(8, values[5]);
+
+    // Objects may be destroyed during the iteration.
+    p.for_each_live([&](Counted& c) {
+        if (c.value % 2 == 0)
+            p.destroy(&c);
+    });
+    ASSERT_EQ(3, Counted::numInstances);
+
+    int count = 0;
+    p.for_each_live([&](Counted& c) {
+        ASSERT_EQ(1, c.value % 2);
+        ++count;
+    });
+    ASSERT_EQ(3, count);
+
+    p.clear();
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(shared_object_pool, clear)
+{
+    weos::shared_object_pool<Counted, 5> p;
+    for (unsigned iter = 0; iter < 3; ++iter)
+    {
+        for (int i = 0; i < 5; ++i)
+            ASSERT_TRUE(p.try_construct(i) != 0);
+        ASSERT_TRUE(p.empty());
+        ASSERT_EQ(5, Counted::numInstances);
+
+        p.clear();
+        ASSERT_FALSE(p.empty());
+        ASSERT_EQ(0, Counted::numInstances);
+        p.for_each_live([](Counted&) { FAIL(); });
+    }
+}
+
+TEST(shared_object_pool, destructor_destroys_live_objects)
+{
+    {
+        weos::shared_object_pool<Counted, 5> p;
+        Counted* c = p.try_construct(1);
+        p.try_construct(2);
+        p.try_construct(3);
+        p.destroy(c);
+        ASSERT_EQ(2, Counted::numInstances);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(shared_object_pool, make_unique)
+{
+    weos::shared_object_pool<Counted, 2> p;
+    {
+        auto c1 = p.make_unique(1);
+        auto c2 = p.make_unique(2);
+        ASSERT_TRUE(c1 != nullptr);
+        ASSERT_TRUE(c2 != nullptr);
+        ASSERT_EQ(1, c1->value);
+        ASSERT_EQ(2, c2->value);
+        ASSERT_TRUE(p.empty());
+
+        // The pool is exhausted.
+        ASSERT_TRUE(p.make_unique(3) == nullptr);
+
+        // The deleter destroys the object and returns the memory.
+        Counted* raw = c1.get();
+        c1.reset();
+        ASSERT_EQ(1, Counted::numInstances);
+        ASSERT_FALSE(p.empty());
+        auto c3 = p.make_unique(3);
+        ASSERT_EQ(raw, c3.get());
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+    ASSERT_FALSE(p.empty());
+}
+
+namespace
+{
+
+struct RefCounted : public weos::pool_ref_counted
+{
+    explicit RefCounted(int v)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    ~RefCounted()
+    {
+        --numInstances;
+    }
+
+    int value;
+    static int numInstances;
+};
+
+int RefCounted::numInstances = 0;
+
+} // anonymous namespace
+
+TEST(shared_object_pool, make_intrusive)
+{
+    weos::shared_object_pool<RefCounted, 2> p;
+    {
+        weos::intrusive_ptr<RefCounted> c1 = p.make_intrusive(1);
+        ASSERT_TRUE(c1 != nullptr);
+        ASSERT_EQ(1, c1->value);
+        ASSERT_EQ(1, RefCounted::numInstances);
+
+        weos::intrusive_ptr<RefCounted> c2 = c1;
+        c1.reset();
+        ASSERT_EQ(1, RefCounted::numInstances);
+        ASSERT_EQ(1, c2->value);
+
+        weos::intrusive_ptr<RefCounted> c3 = p.make_intrusive(3);
+        ASSERT_TRUE(c3 != nullptr);
+        ASSERT_TRUE(p.empty());
+        ASSERT_TRUE(p.make_intrusive(4) == nullptr);
+
+        // Releasing the last reference returns the memory to the pool.
+        c2 = nullptr;
+        ASSERT_EQ(1, RefCounted::numInstances);
+        ASSERT_FALSE(p.empty());
+    }
+    ASSERT_EQ(0, RefCounted::numInstances);
+    ASSERT_FALSE(p.empty());
+}
+
+TEST(shared_object_pool, try_construct_for)
+{
+    weos::shared_object_pool<Counted, 1> p;
+    Counted* c1 = p.try_construct_for(weos::chrono::milliseconds(1), 1);
+    ASSERT_TRUE(c1 != 0);
+    ASSERT_EQ(1, c1->value);
+
+    // The pool is exhausted and the construction times out.
+    auto start = weos::chrono::steady_clock::now();
+    ASSERT_TRUE(p.try_construct_for(weos::chrono::milliseconds(20), 2) == 0);
+    ASSERT_TRUE(weos::chrono::steady_clock::now() - start
+                >= weos::chrono::milliseconds(20));
+    ASSERT_EQ(1, Counted::numInstances);
+
+    // Another thread frees the object before the timeout.
+    weos::thread destroyer([&p, c1] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        p.destroy(c1);
+    });
+    Counted* c2 = p.try_construct_for(weos::chrono::seconds(10), 2);
+    destroyer.join();
+    ASSERT_TRUE(c2 != 0);
+    ASSERT_EQ(2, c2->value);
+    p.destroy(c2);
+}
+
+TEST(shared_object_pool, try_construct_until)
+{
+    weos::shared_object_pool<Counted, 1> p;
+    Counted* c1 = p.try_construct_until(weos::chrono::steady_clock::now(), 1);
+    ASSERT_TRUE(c1 != 0);
+
+    ASSERT_TRUE(p.try_construct_until(weos::chrono::steady_clock::now()
+                                      + weos::chrono::milliseconds(10), 2) == 0);
+    p.destroy(c1);
+
+    Counted* c2 = p.try_construct_until(weos::chrono::steady_clock::now()
+                                        + weos::chrono::milliseconds(10), 2);
+    ASSERT_TRUE(c2 != 0);
+    ASSERT_EQ(2, c2->value);
+    p.destroy(c2);
+    ASSERT_EQ(0, Counted::numInstances);
+}
@@ -0,0 +1,186 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <poolallocator.hpp>
+
+#include "gtest/gtest.h"
+
+#include <list>
+#include <set>
+
+typedef weos::pool_allocator_set<weos::size_class<8, 4>,
+                                 weos::size_class<24, 4>,
+                                 weos::size_class<64, 2, 16>> test_set_t;
+
+TEST(pool_allocator_set, allocate_from_smallest_class)
+{
+    test_set_t s;
+    std::set<void*> chunks;
+
+    // The sizes 0 to 8 are served from the first class.
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        void* c = s.allocate(2 * i, 1);
+        ASSERT_TRUE(c != 0);
+        chunks.insert(c);
+    }
+    // Now the first class is exhausted and the next larger one is used.
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        void* c = s.allocate(8, 8);
+        ASSERT_TRUE(c != 0);
+        chunks.insert(c);
+    }
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        void* c = s.allocate(9, 1);
+        ASSERT_TRUE(c != 0);
+        ASSERT_TRUE(reinterpret_cast<uintptr_t>(c) % 16 == 0);
+        chunks.insert(c);
+    }
+    ASSERT_EQ(10, chunks.size());
+    ASSERT_TRUE(s.allocate(1, 1) == 0);
+
+    for (std::set<void*>::iterator iter = chunks.begin();
+         iter != chunks.end(); ++iter)
+    {
+        s.deallocate(*iter, 1);
+    }
+
+    // All chunks are available again.
+    for (unsigned i = 0; i < 10; ++i)
+        ASSERT_TRUE(s.allocate(1, 1) != 0);
+    ASSERT_TRUE(s.allocate(1, 1) == 0);
+}
+
+TEST(pool_allocator_set, size_and_alignment)
+{
+    test_set_t s;
+
+    ASSERT_EQ(3, test_set_t::num_size_classes);
+    ASSERT_EQ(64, test_set_t::max_size);
+    ASSERT_TRUE(s.allocate(65, 1) == 0);
+
+    void* c = s.allocate(64, 1);
+    ASSERT_TRUE(c != 0);
+    ASSERT_TRUE(s.allocate(40, 1) != 0);
+    ASSERT_TRUE(s.allocate(40, 1) == 0);
+    s.deallocate(c, 64);
+    ASSERT_TRUE(s.allocate(25, 1) != 0);
+
+    // An alignment which is stricter than the one of the 24-byte class
+    // is served by the 64-byte class.
+    weos::pool_allocator_set<weos::size_class<24, 1, 4>,
+                             weos::size_class<64, 1, 16>> s2;
+    c = s2.allocate(24, 16);
+    ASSERT_TRUE(c != 0);
+    ASSERT_TRUE(reinterpret_cast<uintptr_t>(c) % 16 == 0);
+    ASSERT_TRUE(s2.allocate(24, 16) == 0);
+    ASSERT_TRUE(s2.allocate(24, 4) != 0);
+}
+
+TEST(pool_allocator_set, coprime_sizes)
+{
+    // The greatest common divisor of the sizes is 1. The lookup table is
+    // built with a coarser granule instead of one entry per byte.
+    typedef weos::pool_allocator_set<weos::size_class<24, 1, 1>,
+                                     weos::size_class<100, 1, 1>,
+                                     weos::size_class<4097, 1, 1>> set_t;
+    set_t s;
+
+    void* c24 = s.allocate(24, 1);
+    void* c100 = s.allocate(25, 1);
+    void* c4097 = s.allocate(101, 1);
+    ASSERT_TRUE(c24 != 0);
+    ASSERT_TRUE(c100 != 0);
+    ASSERT_TRUE(c4097 != 0);
+    ASSERT_TRUE(s.allocate(1, 1) == 0);
+
+    // Deallocation finds the pools by the same lookup.
+    s.deallocate(c24, 24);
+    s.deallocate(c100, 25);
+    s.deallocate(c4097, 101);
+
+    ASSERT_TRUE(s.allocate(4098, 1) == 0);
+    c4097 = s.allocate(4097, 1);
+    ASSERT_TRUE(c4097 != 0);
+    ASSERT_TRUE(s.allocate(100, 1) != 0);
+    ASSERT_TRUE(s.allocate(18, 1) != 0);
+    ASSERT_TRUE(s.allocate(1, 1) == 0);
+}
+
+TEST(pool_allocator, list)
+{
+    test_set_t s;
+    weos::pool_allocator<int, test_set_t> alloc(s);
+
+    {
+        std::list<int, weos::pool_allocator<int, test_set_t>> l(alloc);
+        for (int i = 0; i < 4; ++i)
+            l.push_back(i);
+        ASSERT_EQ(4, l.size());
+        ASSERT_EQ(0, l.front());
+        ASSERT_EQ(3, l.back());
+    }
+
+    // The list has returned its nodes.
+    for (unsigned i = 0; i < 10; ++i)
+        ASSERT_TRUE(s.allocate(1, 1) != 0);
+}
+
+TEST(pool_allocator, comparison)
+{
+    test_set_t s1, s2;
+    weos::pool_allocator<int, test_set_t> a1(s1);
+    weos::pool_allocator<double, test_set_t> a2(s1);
+    weos::pool_allocator<int, test_set_t> a3(s2);
+
+    ASSERT_TRUE(a1 == a2);
+    ASSERT_FALSE(a1 != a2);
+    ASSERT_TRUE(a1 != a3);
+
+    weos::pool_allocator<double, test_set_t> a4(a1);
+    ASSERT_TRUE(a4 == a1);
+}
+
+TEST(shared_pool_allocator_set, allocate_and_deallocate)
+{
+    weos::shared_pool_allocator_set<weos::size_class<16, 2>,
+                                    weos::size_class<32, 1>> s;
+
+    void* c1 = s.allocate(16, 1);
+    void* c2 = s.allocate(16, 1);
+    void* c3 = s.allocate(16, 1);
+    ASSERT_TRUE(c1 != 0 && c2 != 0 && c3 != 0);
+    ASSERT_TRUE(s.allocate(1, 1) == 0);
+
+    s.deallocate(c3, 16);
+    ASSERT_TRUE(s.allocate(17, 1) == c3);
+    s.deallocate(c1, 16);
+    s.deallocate(c2, 16);
+}
@@ -0,0 +1,229 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <slotmap.hpp>
+
+#include "../common/testutils.hpp"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Counted
+{
+    explicit Counted(int v)
+        : value(v)
+    {
+        ++numInstances;
+    }
+
+    Counted(Counted&& other)
+        : value(other.value)
+    {
+        ++numInstances;
+    }
+
+    ~Counted()
+    {
+        --numInstances;
+    }
+
+    int value;
+    static int numInstances;
+};
+
+int Counted::numInstances = 0;
+
+} // anonymous namespace
+
+TEST(slot_map, Constructor)
+{
+    weos::slot_map<int, 10> m;
+    ASSERT_TRUE(m.empty());
+    ASSERT_FALSE(m.full());
+    ASSERT_EQ(0, m.size());
+    ASSERT_EQ(10, m.capacity());
+    ASSERT_TRUE(m.begin() == m.end());
+    ASSERT_FALSE(m.contains(weos::slot_map<int, 10>::handle_type()));
+}
+
+TEST(slot_map, insert_and_find)
+{
+    typedef weos::slot_map<std::string, 4> map_type;
+    map_type m;
+
+    map_type::handle_type h1 = m.try_insert("one");
+    map_type::handle_type h2 = m.try_emplace(3, 'x');
+    ASSERT_TRUE(h1 != map_type::handle_type());
+    ASSERT_TRUE(h2 != h1);
+    ASSERT_EQ(2, m.size());
+    ASSERT_TRUE(m.contains(h1));
+    ASSERT_EQ("one", *m.find(h1));
+    ASSERT_EQ("xxx", *m.find(h2));
+
+    ASSERT_TRUE(m.try_insert("three") != map_type::handle_type());
+    ASSERT_TRUE(m.try_insert("four") != map_type::handle_type());
+    ASSERT_TRUE(m.full());
+    ASSERT_TRUE(m.try_insert("five") == map_type::handle_type());
+    ASSERT_EQ(4, m.size());
+}
+
+TEST(slot_map, erase_swaps_last_value)
+{
+    typedef weos::slot_map<int, 4> map_type;
+    map_type m;
+    map_type::handle_type h[4];
+    for (int i = 0; i < 4; ++i)
+        h[i] = m.try_insert(i);
+
+    ASSERT_TRUE(m.erase(h[1]));
+    ASSERT_EQ(3, m.size());
+    // The last value has been moved into the gap.
+    ASSERT_EQ(0, m.begin()[0]);
+    ASSERT_EQ(3, m.begin()[1]);
+    ASSERT_EQ(2, m.begin()[2]);
+
+    // The handles of the remaining values are still valid.
+    ASSERT_EQ(0, *m.find(h[0]));
+    ASSERT_EQ(2, *m.find(h[2]));
+    ASSERT_EQ(3, *m.find(h[3]));
+    ASSERT_TRUE(m.get_handle(m.begin() + 1) == h[3]);
+}
+
+TEST(slot_map, stale_handles)
+{
+    typedef weos::slot_map<int, 2> map_type;
+    map_type m;
+
+    map_type::handle_type h1 = m.try_insert(1);
+    ASSERT_TRUE(m.erase(h1));
+    ASSERT_FALSE(m.contains(h1));
+    ASSERT_TRUE(m.find(h1) == 0);
+    ASSERT_FALSE(m.erase(h1));
+
+    // The slot is re-used with a new generation.
+    map_type::handle_type h2 = m.try_insert(2);
+    ASSERT_TRUE(h2 != h1);
+    ASSERT_FALSE(m.contains(h1));
+    ASSERT_TRUE(m.find(h1) == 0);
+    ASSERT_EQ(2, *m.find(h2));
+
+    // Handles of slots which have never been used are invalid.
+    ASSERT_FALSE(m.contains(map_type::handle_type(1)));
+}
+
+TEST(slot_map, erase_while_iterating)
+{
+    weos::slot_map<int, 10> m;
+    for (int i = 0; i < 10; ++i)
+        m.try_insert(i);
+
+    for (auto iter = m.begin(); iter != m.end();)
+    {
+        if (*iter % 2 == 0)
+            iter = m.erase(iter);
+        else
+            ++iter;
+    }
+
+    std::vector<int> values(m.begin(), m.end());
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(5, values.size());
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(2 * i + 1, values[i]);
+}
+
+TEST(slot_map, destroys_values)
+{
+    {
+        weos::slot_map<Counted, 5> m;
+        auto h = m.try_emplace(1);
+        m.try_emplace(2);
+        m.try_emplace(3);
+        ASSERT_EQ(3, Counted::numInstances);
+        m.erase(h);
+        ASSERT_EQ(2, Counted::numInstances);
+
+        m.clear();
+        ASSERT_EQ(0, Counted::numInstances);
+        ASSERT_TRUE(m.empty());
+        ASSERT_FALSE(m.contains(h));
+
+        m.try_emplace(4);
+        m.try_emplace(5);
+    }
+    ASSERT_EQ(0, Counted::numInstances);
+}
+
+TEST(slot_map, random_insert_and_erase)
+{
+    typedef weos::slot_map<int, 20> map_type;
+    map_type m;
+    std::map<std::uint32_t, int> expected;
+    std::vector<map_type::handle_type> stale;
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        if (!m.full() && (expected.empty() || random() % 2))
+        {
+            map_type::handle_type h = m.try_insert(i);
+            ASSERT_TRUE(h != map_type::handle_type());
+            expected[h.value()] = i;
+        }
+        else
+        {
+            auto iter = expected.begin();
+            std::advance(iter, random() % expected.size());
+            map_type::handle_type h(iter->first);
+            ASSERT_TRUE(m.erase(h));
+            stale.push_back(h);
+            expected.erase(iter);
+        }
+
+        ASSERT_EQ(expected.size(), m.size());
+    }
+
+    for (auto& entry : expected)
+    {
+        const int* value = m.find(map_type::handle_type(entry.first));
+        ASSERT_TRUE(value != 0);
+        ASSERT_EQ(entry.second, *value);
+    }
+    for (auto h : stale)
+    {
+        if (expected.find(h.value()) == expected.end())
+        {
+            ASSERT_FALSE(m.contains(h));
+        }
+    }
+}
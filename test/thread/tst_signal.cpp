@@ -119,6 +119,22 @@ void sparring(SparringData* data)
     }
 }
 
+//! Waits until \p flag has the given \p value. The sparring thread polls its
+//! action only every millisecond, so a fixed delay is too short on a loaded
+//! machine. The timeout is generous; the caller asserts on the outcome.
+void waitUntil(volatile bool& flag, bool value)
+{
+    for (int i = 0; i < 1000 && flag != value; ++i)
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+}
+
+//! Waits until the sparring thread has completed its current action.
+void waitUntilIdle(SparringData& data)
+{
+    for (int i = 0; i < 1000 && data.action != SparringData::None; ++i)
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(1));
+}
+
 } // anonymous namespace
 
 TEST(signal, no_signals_in_new_thread)
@@ -136,12 +152,12 @@ TEST(signal, no_signals_in_new_thread)
         }
 
         threads[idx] = weos::thread(sparring, &data[idx]);
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+        waitUntil(data[idx].sparringStarted, true);
         ASSERT_TRUE(data[idx].sparringStarted);
 
         data[idx].caughtSignals = 0;
         data[idx].action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(5));
+        waitUntilIdle(data[idx]);
         ASSERT_FALSE(data[idx].busy);
         ASSERT_EQ(0, data[idx].caughtSignals);
 
@@ -164,7 +180,7 @@ TEST(signal, set_signals)
 {
     SparringData data;
     weos::thread t(sparring, &data);
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntil(data.sparringStarted, true);
     ASSERT_TRUE(data.sparringStarted);
 
     // Set all signal flags and catch them.
@@ -172,13 +188,13 @@ TEST(signal, set_signals)
     weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
     data.caughtSignals = 0;
     data.action = SparringData::TryWaitForAnySignal;
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntilIdle(data);
     ASSERT_FALSE(data.busy);
     ASSERT_EQ(weos::thread::all_signals(), data.caughtSignals);
 
     // Make sure that the signal flags have been cleared.
     data.action = SparringData::TryWaitForAnySignal;
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntilIdle(data);
     ASSERT_FALSE(data.busy);
     ASSERT_EQ(0, data.caughtSignals);
 
@@ -189,13 +205,13 @@ TEST(signal, set_signals)
         t.set_signals(flag);
     }
     data.action = SparringData::TryWaitForAnySignal;
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntilIdle(data);
     ASSERT_FALSE(data.busy);
     ASSERT_EQ(weos::thread::all_signals(), data.caughtSignals);
 
     // Make sure that the signal flags have been cleared.
     data.action = SparringData::TryWaitForAnySignal;
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntilIdle(data);
     ASSERT_FALSE(data.busy);
     ASSERT_EQ(0, data.caughtSignals);
 
@@ -207,7 +223,7 @@ TEST(signal, wait_for_any_signal)
 {
     SparringData data;
     weos::thread t(sparring, &data);
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntil(data.sparringStarted, true);
     ASSERT_TRUE(data.sparringStarted);
 
     // Set a single signal and assert that it is caught.
@@ -217,18 +233,19 @@ TEST(signal, wait_for_any_signal)
 
         data.caughtSignals = 0;
         data.action = SparringData::WaitForAnySignal;
+        waitUntil(data.busy, true);
         weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
         ASSERT_TRUE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
 
         t.set_signals(flag);
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(flag, data.caughtSignals);
 
         // Make sure that the signal flags have been cleared.
         data.action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
     }
@@ -237,18 +254,19 @@ TEST(signal, wait_for_any_signal)
     {
         data.caughtSignals = 0;
         data.action = SparringData::WaitForAnySignal;
+        waitUntil(data.busy, true);
         weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
         ASSERT_TRUE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
 
         t.set_signals(weos::thread::all_signals());
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(weos::thread::all_signals(), data.caughtSignals);
 
         // Make sure that the signal flags have been cleared.
         data.action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
     }
@@ -261,7 +279,7 @@ TEST(signal, wait_for_any_signal_randomly)
 {
     SparringData data;
     weos::thread t(sparring, &data);
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntil(data.sparringStarted, true);
     ASSERT_TRUE(data.sparringStarted);
 
     // Set a bunch of signals and assert that all of them are caught.
@@ -272,18 +290,19 @@ TEST(signal, wait_for_any_signal_randomly)
 
         data.caughtSignals = 0;
         data.action = SparringData::WaitForAnySignal;
+        waitUntil(data.busy, true);
         weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
         ASSERT_TRUE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
 
         t.set_signals(flag);
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(flag, data.caughtSignals);
 
         // Make sure that the signal flags have been cleared.
         data.action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
     }
@@ -296,7 +315,7 @@ TEST(signal, wait_for_all_signals)
 {
     SparringData data;
     weos::thread t(sparring, &data);
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntil(data.sparringStarted, true);
     ASSERT_TRUE(data.sparringStarted);
 
     // Wait for a single signal.
@@ -307,6 +326,7 @@ TEST(signal, wait_for_all_signals)
         data.caughtSignals = 0;
         data.waitFlags = flag;
         data.action = SparringData::WaitForAllSignals;
+        waitUntil(data.busy, true);
         weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
         ASSERT_TRUE(data.busy);
         ASSERT_EQ(0, data.caughtSignals);
@@ -324,13 +344,13 @@ TEST(signal, wait_for_all_signals)
 
         // Set the remaining signal.
         t.set_signals(flag);
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(flag, data.caughtSignals);
 
         // The other signals should still be intact.
         data.action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(weos::thread::all_signals() & ~flag, data.caughtSignals);
     }
@@ -343,7 +363,7 @@ TEST(signal, wait_for_all_signals_randomly)
 {
     SparringData data;
     weos::thread t(sparring, &data);
-    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    waitUntil(data.sparringStarted, true);
     ASSERT_TRUE(data.sparringStarted);
 
     for (int i = 0; i < 100; ++i)
@@ -354,6 +374,7 @@ TEST(signal, wait_for_all_signals_randomly)
         data.caughtSignals = 0;
         data.waitFlags = flags;
         data.action = SparringData::WaitForAllSignals;
+        waitUntil(data.busy, true);
         weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
         ASSERT_TRUE(data.busy);
         ASSERT_TRUE(data.caughtSignals == 0);
@@ -364,14 +385,15 @@ TEST(signal, wait_for_all_signals_randomly)
             weos::thread::signal_set flag = 1 << j;
             temp &= ~flag;
             t.set_signals(flag);
-            weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
             if (temp != 0)
             {
+                weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
                 ASSERT_TRUE(data.busy);
                 ASSERT_EQ(0, data.caughtSignals);
             }
             else
             {
+                waitUntilIdle(data);
                 ASSERT_FALSE(data.busy);
                 ASSERT_TRUE(data.caughtSignals != 0);
             }
@@ -379,7 +401,7 @@ TEST(signal, wait_for_all_signals_randomly)
 
         // The other signals should still be intact.
         data.action = SparringData::TryWaitForAnySignal;
-        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        waitUntilIdle(data);
         ASSERT_FALSE(data.busy);
         ASSERT_EQ(weos::thread::all_signals() & ~flags,
                   data.caughtSignals);
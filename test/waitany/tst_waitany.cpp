@@ -0,0 +1,193 @@
+/*******************************************************************************
+  WEOS - Wrapper for embedded operating systems
+
+  Copyright (c) 2013-2016, Manuel Freiberger
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+  POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+#include <waitany.hpp>
+#include <mailqueue.hpp>
+#include <messagequeue.hpp>
+#include <semaphore.hpp>
+#include <thread.hpp>
+
+#include "gtest/gtest.h"
+
+TEST(wait_any, try_wait_any)
+{
+    weos::message_queue<int, 2> q1;
+    weos::spsc_message_queue<int, 2> q2;
+    weos::semaphore sem;
+
+    ASSERT_EQ(-1, weos::try_wait_any(q1, q2, sem));
+
+    q2.send(1);
+    ASSERT_EQ(1, weos::try_wait_any(q1, q2, sem));
+    sem.post();
+    ASSERT_EQ(1, weos::try_wait_any(q1, q2, sem));
+    q1.send(1);
+    ASSERT_EQ(0, weos::try_wait_any(q1, q2, sem));
+
+    // Waiting does not take anything from the sources.
+    ASSERT_EQ(0, weos::wait_any(q1, q2, sem));
+    ASSERT_EQ(1, q1.receive());
+    ASSERT_EQ(1, q2.receive());
+    ASSERT_EQ(2, weos::wait_any(q1, q2, sem));
+    ASSERT_TRUE(sem.try_wait());
+}
+
+TEST(wait_any, timeout)
+{
+    weos::message_queue<int, 2> q;
+    weos::semaphore sem;
+
+    ASSERT_EQ(-1, weos::try_wait_any_for(weos::chrono::milliseconds(10),
+                                         q, sem));
+    ASSERT_EQ(-1, weos::try_wait_any_until(weos::chrono::steady_clock::now()
+                                           + weos::chrono::milliseconds(10),
+                                           q, sem));
+    sem.post();
+    ASSERT_EQ(1, weos::try_wait_any_for(weos::chrono::milliseconds(10),
+                                        q, sem));
+}
+
+TEST(wait_any, wakes_up_on_queues)
+{
+    weos::message_queue<int, 2> q1;
+    weos::priority_message_queue<int, 2, 4> q2;
+    weos::mail_queue<int, 2> q3;
+
+    weos::thread sender([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        q2.send(2, 3);
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        q3.send(q3.allocate(3));
+    });
+
+    ASSERT_EQ(1, weos::wait_any(q1, q2, q3));
+    int value;
+    ASSERT_TRUE(q2.try_receive(value));
+    ASSERT_EQ(2, value);
+
+    ASSERT_EQ(2, weos::wait_any(q1, q2, q3));
+    auto mail = q3.try_receive();
+    ASSERT_TRUE(mail != nullptr);
+    ASSERT_EQ(3, *mail);
+
+    sender.join();
+}
+
+TEST(wait_any, wakes_up_on_semaphore)
+{
+    weos::message_queue<int, 2> q;
+    weos::semaphore sem;
+
+    weos::thread poster([&] {
+        weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+        sem.post();
+    });
+
+    ASSERT_EQ(1, weos::wait_any(q, sem));
+    ASSERT_TRUE(sem.try_wait());
+    poster.join();
+}
+
+TEST(wait_any, wakes_up_on_signal)
+{
+    weos::message_queue<int, 2> q;
+    int result = -2;
+    weos::thread::signal_set signals = 0;
+
+    weos::thread waiter([&] {
+        result = weos::wait_any(q, weos::thread::signal_set(0x0C));
+        signals = weos::this_thread::try_wait_for_any_signal();
+    });
+
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    // A signal, which is not in the mask, does not wake the waiter.
+    waiter.set_signals(0x01);
+    weos::this_thread::sleep_for(weos::chrono::milliseconds(10));
+    ASSERT_EQ(-2, result);
+    waiter.set_signals(0x08);
+    waiter.join();
+
+    ASSERT_EQ(1, result);
+    ASSERT_EQ(0x09, signals);
+}
+
+TEST(wait_any, consumers_of_two_queues)
+{
+    const int NUM_CONSUMERS = 3;
+    const int NUM_MESSAGES = 5000;
+
+    weos::message_queue<int, 4> q1;
+    weos::message_queue<int, 4> q2;
+    long sums[NUM_CONSUMERS] = {0};
+
+    weos::thread consumers[NUM_CONSUMERS];
+    for (int idx = 0; idx < NUM_CONSUMERS; ++idx)
+    {
+        consumers[idx] = weos::thread([&, idx] {
+            for (;;)
+            {
+                int value;
+                int ready = weos::wait_any(q1, q2);
+                if (ready == 0 && q1.try_receive(value))
+                {
+                    // A zero in the first queue stops the consumer.
+                    if (value == 0)
+                        break;
+                    sums[idx] += value;
+                }
+                else if (ready == 1 && q2.try_receive(value))
+                {
+                    sums[idx] += value;
+                }
+            }
+        });
+    }
+
+    weos::thread producer([&] {
+        for (int i = 1; i <= NUM_MESSAGES; ++i)
+            q2.send(i);
+    });
+    for (int i = 1; i <= NUM_MESSAGES; ++i)
+        q1.send(i);
+    producer.join();
+
+    // Wait until the second queue has been emptied before stopping the
+    // consumers.
+    while (weos::try_wait_any(q2) == 0)
+        weos::this_thread::yield();
+    for (int idx = 0; idx < NUM_CONSUMERS; ++idx)
+        q1.send(0);
+
+    long total = 0;
+    for (int idx = 0; idx < NUM_CONSUMERS; ++idx)
+    {
+        consumers[idx].join();
+        total += sums[idx];
+    }
+    ASSERT_EQ(2L * NUM_MESSAGES * (NUM_MESSAGES + 1) / 2, total);
+}